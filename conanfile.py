@@ -8,11 +8,16 @@ from conan.tools.files import copy
 class ImGuiExample(ConanFile):
     settings = "os", "compiler", "build_type", "arch"
     generators = "CMakeDeps", "CMakeToolchain"
+    # -o viewer=False for headless render nodes, pair it with -DBUILD_VIEWER=OFF
+    options = {"viewer": [True, False]}
+    default_options = {"viewer": True}
 
     def requirements(self):
         self.requires("fmt/10.0.0")
         self.requires("glm/cci.20230113")
-        self.requires("glfw/3.3.8")
         self.requires("catch2/3.4.0")
-        self.requires("vulkan-headers/1.3.250.0")
+        self.requires("nlohmann_json/3.11.2")
+        if self.options.viewer:
+            self.requires("glfw/3.3.8")
+            self.requires("vulkan-headers/1.3.250.0")
         
\ No newline at end of file
@@ -0,0 +1,27 @@
+#!/bin/bash
+set -x
+set -e
+
+# renders one frame as WORKERS local processes over disjoint sample ranges, then merges them
+# usage: ./split-render.sh WORKERS SPP OUTPUT [renderer-headless options, e.g. --scene --threads]
+workers=$1
+spp=$2
+output=$3
+shift 3
+
+cmake --build build
+pids=()
+parts=()
+for i in $(seq 0 $((workers - 1))); do
+    begin=$((spp * i / workers))
+    end=$((spp * (i + 1) / workers))
+    part="build/part-$i.checkpoint"
+    rm -f "$part"
+    ./build/renderer-headless "$@" --samples "$begin:$end" --checkpoint "$part" --output "build/part-$i.pfm" &
+    pids+=($!)
+    parts+=("$part")
+done
+for pid in "${pids[@]}"; do
+    wait "$pid"
+done
+./build/merge-partials --output "$output" "${parts[@]}"
@@ -0,0 +1,421 @@
+#include <fmt/core.h>
+
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#endif
+
+#include "ray-tracing/Camera.hpp"
+#include "ray-tracing/Checkpoint.hpp"
+#include "ray-tracing/CornellBox.hpp"
+#include "ray-tracing/RenderFarm.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "ray-tracing/SceneFile.hpp"
+#include "utils/BMP.hpp"
+#include "utils/ImageWriter.hpp"
+#include "utils/Socket.hpp"
+
+using namespace RayTracer;
+
+/*
+renders a scene without a window or gpu and writes the result, for machines without a display.
+stops at the target spp, after the time limit or once adaptive sampling converged,
+whichever comes first. with --checkpoint the accumulation is saved every --checkpoint-interval
+seconds and once more at the end, --resume continues from that file after a crash or preemption,
+or with a higher --spp.
+--samples BEGIN:END renders only that range of every pixel's sample indices into the checkpoint,
+merge-partials sums the checkpoints of disjoint ranges into the image one process would render.
+--farm N splits the frame by tiles across N worker processes instead. without --listen they are
+started on this machine, with it they are started elsewhere as renderer-headless --worker
+HOST:PORT with the same --scene, --width, --height and --bounces
+*/
+
+#ifndef WIN32
+extern char** environ;
+#endif
+
+// unset values come from the scene
+struct Options {
+    std::string scene = "cornell-empty";
+    std::optional<u32> width;
+    std::optional<u32> height;
+    std::optional<u32> spp;
+    // seconds, 0 renders until the spp are reached
+    f64 time_limit = 0;
+    // 0 uses every hardware thread
+    u32 threads = 0;
+    std::optional<u32> bounces;
+    std::string output = "render.bmp";
+    // empty disables checkpoints
+    std::string checkpoint;
+    f64 checkpoint_interval = 60;
+    bool resume = false;
+    // [begin, end) of the sample indices, set when this process renders one part of a split frame
+    std::optional<std::pair<u32, u32>> samples;
+    // coordinate this many render farm workers instead of rendering
+    std::optional<u32> farm;
+    // HOST:PORT the coordinator waits for workers on, unset starts them locally
+    std::string listen;
+    // HOST:PORT of the coordinator, set when this process is a render farm worker
+    std::string worker;
+    f64 lease_timeout = 60;
+};
+
+// the built in box with the two cubes, their meshes are not in the repository
+static bool has_cube_meshes() {
+    return std::filesystem::exists("cube1.obj") && std::filesystem::exists("cube2.obj");
+}
+
+static void print_usage(const char* program) {
+    fmt::println(
+        "usage: {} [--scene {}cornell-empty|FILE.json] [--width N] [--height N] [--spp N] [--time SECONDS] "
+        "[--threads N] [--bounces N] [--output FILE.bmp|FILE.png|FILE.pfm] [--checkpoint FILE] "
+        "[--checkpoint-interval SECONDS] [--resume] [--samples BEGIN:END] [--farm N] [--listen HOST:PORT] "
+        "[--lease-timeout SECONDS] [--worker HOST:PORT]",
+        program, has_cube_meshes() ? "cornell|" : ""
+    );
+}
+
+// the whole text has to be the number, like parse_address does for the port
+template <typename T>
+static bool parse_number(std::string_view text, T& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--resume") {
+            options.resume = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string_view value = argv[++i];
+        bool valid = true;
+        if (arg == "--scene") {
+            options.scene = value;
+        } else if (arg == "--width") {
+            valid = parse_number(value, options.width.emplace());
+        } else if (arg == "--height") {
+            valid = parse_number(value, options.height.emplace());
+        } else if (arg == "--spp") {
+            valid = parse_number(value, options.spp.emplace());
+        } else if (arg == "--time") {
+            valid = parse_number(value, options.time_limit);
+        } else if (arg == "--threads") {
+            valid = parse_number(value, options.threads);
+        } else if (arg == "--bounces") {
+            valid = parse_number(value, options.bounces.emplace());
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--checkpoint") {
+            options.checkpoint = value;
+        } else if (arg == "--checkpoint-interval") {
+            valid = parse_number(value, options.checkpoint_interval);
+        } else if (arg == "--samples") {
+            size_t colon = value.find(':');
+            std::pair<u32, u32>& samples = options.samples.emplace();
+            valid = colon != std::string_view::npos && parse_number(value.substr(0, colon), samples.first) &&
+                    parse_number(value.substr(colon + 1), samples.second);
+        } else if (arg == "--farm") {
+            valid = parse_number(value, options.farm.emplace());
+        } else if (arg == "--listen") {
+            options.listen = value;
+        } else if (arg == "--worker") {
+            options.worker = value;
+        } else if (arg == "--lease-timeout") {
+            valid = parse_number(value, options.lease_timeout);
+        } else {
+            return false;
+        }
+        if (!valid) {
+            return false;
+        }
+    }
+    // farm renders always take the full spp, they do not checkpoint or stop early
+    bool farm = options.farm.has_value() || !options.worker.empty();
+    return options.width.value_or(1) > 0 && options.height.value_or(1) > 0 && image_format(options.output).has_value() &&
+           (!options.resume || !options.checkpoint.empty()) &&
+           (!options.samples.has_value() || (options.samples->first < options.samples->second && !options.checkpoint.empty())) &&
+           (!farm || (!options.samples.has_value() && options.checkpoint.empty() && options.time_limit <= 0)) &&
+           (!options.farm.has_value() || (*options.farm > 0 && options.worker.empty())) &&
+           (options.listen.empty() || (options.farm.has_value() && parse_address(options.listen).has_value())) &&
+           (options.worker.empty() || parse_address(options.worker).has_value());
+}
+
+// a checkpoint only resumes into the same scene file (or built in scene) and bounce count
+static u64 scene_fingerprint(const Options& options, u32 bounces) {
+    std::string scene = options.scene;
+    if (options.scene.ends_with(".json")) {
+        std::stringstream text;
+        text << std::ifstream(options.scene).rdbuf();
+        scene = text.str();
+    }
+    return checkpoint_fingerprint(fmt::format("{}\n{}", scene, bounces));
+}
+
+static std::optional<SceneDescription> built_in_scene(std::string_view name) {
+    if (name != "cornell-empty" && (name != "cornell" || !has_cube_meshes())) {
+        return std::nullopt;
+    }
+    SceneDescription description;
+    description.camera.position = CORNELL_CAMERA_POSITION;
+    return description;
+}
+
+#ifdef WIN32
+using Process = HANDLE;
+#else
+using Process = pid_t;
+#endif
+
+static std::optional<Process> start_process(const std::vector<std::string>& arguments) {
+#ifdef WIN32
+    std::string command_line;
+    for (const std::string& argument : arguments) {
+        command_line += fmt::format("\"{}\" ", argument);
+    }
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process{};
+    if (!CreateProcessA(nullptr, command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process)) {
+        return std::nullopt;
+    }
+    CloseHandle(process.hThread);
+    return process.hProcess;
+#else
+    std::vector<char*> argv;
+    for (const std::string& argument : arguments) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+        return std::nullopt;
+    }
+    return pid;
+#endif
+}
+
+static void wait_for_process(Process process) {
+#ifdef WIN32
+    WaitForSingleObject(process, INFINITE);
+    CloseHandle(process);
+#else
+    waitpid(process, nullptr, 0);
+#endif
+}
+
+// fills the camera with the tiles the workers rendered, false when the frame is incomplete
+static bool render_farm(
+    const char* program, const Options& options, Camera& cam, const RenderSettings& settings, u32 spp, u32 bounces,
+    u64 fingerprint
+) {
+    u32 workers = *options.farm;
+    std::pair<std::string, u16> address =
+        options.listen.empty() ? std::pair<std::string, u16>("127.0.0.1", 0) : *parse_address(options.listen);
+    Socket listener = Socket::listen(address.first, address.second);
+    if (!listener.is_open()) {
+        fmt::println("could not listen on {}:{}", address.first, address.second);
+        return false;
+    }
+    std::vector<Process> processes;
+    if (options.listen.empty()) {
+        u32 threads = options.threads > 0 ? options.threads : std::max(std::thread::hardware_concurrency() / workers, 1u);
+        for (u32 i = 0; i < workers; ++i) {
+            std::optional<Process> process = start_process({
+                program, "--scene", options.scene, "--width", std::to_string(cam.window_width), "--height",
+                std::to_string(cam.window_height), "--bounces", std::to_string(bounces), "--threads", std::to_string(threads),
+                "--worker", fmt::format("127.0.0.1:{}", listener.port()),
+            });
+            if (process.has_value()) {
+                processes.push_back(*process);
+            }
+        }
+        fmt::println("started {} local workers with {} threads each", processes.size(), threads);
+    } else {
+        fmt::println("waiting for {} workers on {}:{}", workers, address.first, listener.port());
+    }
+
+    FarmStats stats;
+    FarmSettings farm{
+        .worker_count = workers, .spp = spp, .lease_timeout_seconds = options.lease_timeout, .scene_fingerprint = fingerprint
+    };
+    bool complete = run_farm_coordinator(listener, cam, settings, farm, &stats);
+    // workers that did not connect yet find nobody listening and exit
+    listener.close();
+    for (Process process : processes) {
+        wait_for_process(process);
+    }
+    fmt::println(
+        "{} workers ({} rejected), {} leases expired, {} stolen, {} tiles rendered twice", stats.workers,
+        stats.rejected_workers, stats.expired_leases, stats.stolen_leases, stats.duplicate_tiles
+    );
+    return complete;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    bool scene_file = options.scene.ends_with(".json");
+    SceneLoadTimings timings;
+    std::optional<SceneDescription> description =
+        scene_file ? parse_scene_file(options.scene, &timings) : built_in_scene(options.scene);
+    if (!description.has_value()) {
+        fmt::println("unknown scene {}", options.scene);
+        print_usage(argv[0]);
+        return 1;
+    }
+    CameraDescription& camera = description->camera;
+    camera.width = options.width.value_or(camera.width);
+    camera.height = options.height.value_or(camera.height);
+    u32 spp = options.spp.value_or(description->spp);
+    u32 bounces = options.bounces.value_or(description->max_bounces);
+
+    Camera cam(camera.vfov, camera.position, camera.pitch, camera.yaw, camera.width, camera.height);
+    Scene scene(cam, options.threads);
+    if (options.farm.has_value()) {
+        // the coordinator only stitches tiles, the meshes are loaded by the workers
+        scene.settings = description->settings;
+    } else if (scene_file) {
+        load_scene(*description, scene, &timings);
+        fmt::println(
+            "parsed {} in {:.1f}ms, loaded {} meshes with {} triangles in {:.1f}ms", options.scene, timings.parse_ms,
+            description->meshes.size(), timings.triangles, timings.load_ms
+        );
+    } else {
+        load_cornell_box(scene, options.scene == "cornell");
+    }
+    if (options.samples.has_value()) {
+        scene.settings.sample_offset = options.samples->first;
+        spp = options.samples->second - options.samples->first;
+        // convergence depends on the samples seen so far, which differ between the parts
+        scene.settings.adaptive_target_error = 0.0f;
+    }
+    // short steps so the time limit is checked often, partial passes stay unbiased
+    if (options.time_limit > 0) {
+        scene.settings.frame_budget_ms = 100.0f;
+    }
+    u64 fingerprint = scene_fingerprint(options, bounces);
+    if (!options.worker.empty()) {
+        std::pair<std::string, u16> address = *parse_address(options.worker);
+        Socket coordinator = Socket::connect(address.first, address.second);
+        if (!coordinator.is_open()) {
+            fmt::println("could not connect to {}", options.worker);
+            return 1;
+        }
+        fmt::println("farm worker for {} on {} threads", options.worker, scene.thread_count());
+        if (!run_farm_worker(coordinator, scene, bounces, fingerprint)) {
+            fmt::println("the coordinator at {} rejected this worker or went away", options.worker);
+            return 1;
+        }
+        return 0;
+    }
+    if (options.resume) {
+        if (load_checkpoint(options.checkpoint, cam, scene.settings, fingerprint)) {
+            fmt::println("resumed {} at {} spp", options.checkpoint, cam.frame_index - 1);
+        } else {
+            fmt::println("no checkpoint at {}, starting from scratch", options.checkpoint);
+        }
+    }
+    auto save_checkpoint = [&] {
+        if (write_checkpoint(options.checkpoint, cam, scene.settings, fingerprint)) {
+            fmt::println("checkpoint at {} spp", cam.frame_index - 1);
+        } else {
+            fmt::println("could not write checkpoint {}", options.checkpoint);
+        }
+    };
+    if (options.farm.has_value()) {
+        fmt::println(
+            "rendering {} at {}x{} on {} farm workers, {} spp", options.scene, cam.window_width, cam.window_height,
+            *options.farm, spp
+        );
+    } else {
+        fmt::println(
+            "rendering {} at {}x{} on {} threads, {} spp", options.scene, cam.window_width, cam.window_height,
+            scene.thread_count(), spp
+        );
+    }
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    clock::time_point last_report = start;
+    clock::time_point last_checkpoint = start;
+    u32 first_pass = cam.frame_index;
+    f64 elapsed = 0;
+    // the farm leaves every pixel at spp samples, the loop below then has nothing left to do
+    if (options.farm.has_value()) {
+        if (!render_farm(argv[0], options, cam, scene.settings, spp, bounces, fingerprint)) {
+            fmt::println("the farm did not finish the frame");
+            return 1;
+        }
+        elapsed = std::chrono::duration<f64>(clock::now() - start).count();
+    }
+    // frame_index counts completed passes from 1
+    while (cam.frame_index <= spp && !scene.converged() &&
+           (options.time_limit <= 0 || elapsed < options.time_limit)) {
+        scene.render(bounces, scene.epoch.current(), spp + 1);
+        elapsed = std::chrono::duration<f64>(clock::now() - start).count();
+        if (clock::now() - last_report >= std::chrono::seconds(1)) {
+            last_report = clock::now();
+            fmt::println("{} spp, {:.1f}s", cam.frame_index - 1, elapsed);
+        }
+        // between passes so every pixel of a periodic checkpoint has the same sample count. a
+        // partial pass, like the final one after a time limit, still resumes correctly
+        if (!options.checkpoint.empty() && scene.pass_tiles_left() == 0 &&
+            clock::now() - last_checkpoint >= std::chrono::duration<f64>(options.checkpoint_interval)) {
+            save_checkpoint();
+            last_checkpoint = clock::now();
+        }
+    }
+    if (!options.checkpoint.empty()) {
+        save_checkpoint();
+    }
+
+    u32 passes = cam.frame_index - first_pass;
+    // nothing was rendered when a resumed checkpoint already had every sample
+    f64 paths_per_second = elapsed > 0 ? (f64)passes * cam.window_width * cam.window_height / elapsed : 0;
+    fmt::println("{} spp in {:.2f}s, {:.2f} Mpaths/s", passes, elapsed, paths_per_second / 1e6);
+    bool written = false;
+    switch (*image_format(options.output)) {
+        case ImageFormat::BMP:
+            scene.resolve_image();
+            written = write_bmp_image(options.output, cam.image, cam.window_width, cam.window_height);
+            break;
+        case ImageFormat::PNG:
+            scene.resolve_image();
+            written = write_png_image(options.output, cam.image, cam.window_width, cam.window_height);
+            break;
+        case ImageFormat::PFM:
+            written = write_pfm_image(options.output, cam.hdr_image(), cam.window_width, cam.window_height);
+            break;
+    }
+    if (!written) {
+        fmt::println("could not write {}", options.output);
+        return 1;
+    }
+    fmt::println("wrote {}", options.output);
+    return 0;
+}
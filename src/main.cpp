@@ -3,6 +3,9 @@
 #include <chrono>
 #include <exception>
 #include <fstream>
+#include <future>
+#include <string>
+#include <string_view>
 #include <thread>
 
 #include "linear_algebra/ONB.hpp"
@@ -10,7 +13,9 @@
 #include "linear_algebra/Vec3.hpp"
 #include "ray-tracing/Camera.hpp"
 #include "ray-tracing/Material.hpp"
+#include "ray-tracing/RenderThread.hpp"
 #include "ray-tracing/Scene.hpp"
+#include "ray-tracing/SceneFile.hpp"
 #include "ray-tracing/objects.hpp"
 #include "renderer/renderer.hpp"
 #include "utils/BMP.hpp"
@@ -19,69 +24,60 @@
 
 using namespace RayTracer;
 
-constexpr Vec3f u8_color_to_float(Vec3<u8>&& color) {
-    return Vec3f(color.x / 255.0f, color.y / 255.0f, color.z / 255.0f);
-}
+int main(int argc, char** argv) {
+    // 0 uses every hardware thread
+    u32 thread_count = 0;
+    std::string scene_path = "scenes/cornell.json";
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            thread_count = (u32)std::stoul(argv[++i]);
+        } else if (arg == "--scene" && i + 1 < argc) {
+            scene_path = argv[++i];
+        } else {
+            fmt::println("usage: {} [--threads N] [--scene FILE.json]", argv[0]);
+            return 1;
+        }
+    }
 
-int main() {
-    Camera cam(45, Vec3f(0.046539098f, -0.042931885f, 5.7400503f), 0, 0, 1280, 1280);
+    using clock = std::chrono::steady_clock;
+    clock::time_point startup = clock::now();
+    auto ms_since = [](clock::time_point start) {
+        return std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+    };
+
+    // short frames and a coarse preview while the camera moves, unless the scene file says otherwise
+    RenderSettings viewer_settings;
+    viewer_settings.frame_budget_ms = 16.0f;
+    viewer_settings.preview_scale = 8;
+    viewer_settings.temporal_reprojection = true;
+    SceneLoadTimings timings;
+    SceneDescription description = parse_scene_file(scene_path, &timings, viewer_settings);
+    const CameraDescription& camera = description.camera;
+    Camera cam(camera.vfov, camera.position, camera.pitch, camera.yaw, camera.width, camera.height);
+    Scene scene(cam, thread_count);
+    fmt::println("rendering on {} threads", scene.thread_count());
+
+    // meshes and the environment map load while vulkan initializes, neither side touches the other's state
+    std::future<void> assets = std::async(std::launch::async, [&description, &scene, &timings] {
+        load_scene(description, scene, &timings);
+    });
+    clock::time_point vulkan_start = clock::now();
     Window w(cam);
     auto r = renderer::Renderer(w);
-    Scene scene(cam);
-    scene.add_object(
-        Mesh(
-            Vec3f(), 
-            Material({
-                .type = MaterialType::EMISSIVE, 
-                .albedo = Vec3(1.0f, 1.0f, 1.0f), 
-                .emission_power = 2.5f}
-            ), 
-            load_obj("light.obj")
-        )
+    f64 vulkan_ms = ms_since(vulkan_start);
+    clock::time_point wait_start = clock::now();
+    assets.get();
+    f64 waited_ms = ms_since(wait_start);
+
+    fmt::println(
+        "parsed {} in {:.1f}ms, loaded {} meshes with {} triangles in {:.1f}ms", scene_path, timings.parse_ms,
+        description.meshes.size(), timings.triangles, timings.load_ms
+    );
+    fmt::println(
+        "startup: window and vulkan {:.1f}ms, assets {:.1f}ms alongside, waited {:.1f}ms for them, {:.1f}ms total",
+        vulkan_ms, timings.load_ms, waited_ms, ms_since(startup)
     );
-
-    //scene.add_object(Sphere(
-    //    Vec3f(-.5f, -0.59f, 0.f), 0.4f,
-    //    Material({
-    //        .type = MaterialType::METAL,
-    //        .albedo = u8_color_to_float(Vec3<u8>(218, 165, 32)),
-    //        .roughness = 0.05f,
-    //    })
-    //));
-
-    //scene.add_object(Sphere(
-    //    Vec3f(.5f, -0.59f, 0.f), 0.4f,
-    //    Material({
-    //        .type = MaterialType::METAL,
-    //        .albedo = u8_color_to_float(Vec3<u8>(218, 165, 32)),
-    //        .roughness = 0.05f,
-    //    })
-    //));
-    scene.add_object(Mesh(
-        Vec3f(),
-        Material({
-            .type = MaterialType::METAL,
-            .albedo = u8_color_to_float(Vec3<u8>(255)),
-            .roughness = 0.0f,
-        }),
-        load_obj("cube1.obj")
-    ));
-
-    scene.add_object(Mesh(
-        Vec3f(),
-        Material({
-            .type = MaterialType::LAMBERTIAN,
-            .albedo = u8_color_to_float(Vec3<u8>(218, 165, 32)),
-        }),
-        load_obj("cube2.obj")
-    ));
-    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(1, 0, 0)}), load_obj("left.obj")));
-
-    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(0, 1, 0)}), load_obj("right.obj")));
-
-    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(1, 1, 1)}), load_obj("floor.obj")));
-
-    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(1, 1, 1)}), load_obj("back.obj")));
 
     u32 selected_index = 1;
     w.custom_key_cbs.push_back(CustomKeyCallback{
@@ -121,28 +117,59 @@ int main() {
                 cam.reset_accu_data();
             },
     });
-    u32 spp = 4096;
+    u32 spp = description.spp;
+
+    RenderThread tracer(scene, description.max_bounces, spp);
+    w.commands = &tracer.commands;
+    w.frame_epoch = &scene.epoch;
+    tracer.start();
+
+    // shown until the tracer publishes a frame of the current size
+    std::vector<Vec4<u8>> placeholder(cam.window_width * cam.window_height);
+    u32 presented_width = cam.window_width;
+    u32 presented_height = cam.window_height;
+    r.update_image(reinterpret_cast<u8*>(placeholder.data()));
+    bool first_frame_presented = false;
 
     while (!glfwWindowShouldClose(w.m_glfw_window)) {
         glfwPollEvents();
-        if (scene.m_camera.frame_index < spp) {
-            scene.render(8);
-        } else {
+        if (tracer.finished()) {
+            tracer.stop();
+            scene.resolve_image();
             write_bmp_image("D:\\render.bmp", cam.image, cam.window_width, cam.window_height);
             std::terminate();
         }
         if (w.framebuffer_resized) {
+            // the camera is resized on the render thread, wait for it before rebuilding the swap chain
+            tracer.sync();
             r.recreate_swap_chain();
             w.framebuffer_resized = false;
             r.wait_for_device_idle();
+            presented_width = cam.window_width;
+            presented_height = cam.window_height;
+            placeholder.assign(presented_width * presented_height, Vec4<u8>());
+            r.update_image(reinterpret_cast<u8*>(placeholder.data()));
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
         }
 
-        r.update_image(reinterpret_cast<u8*>(cam.image.data()));
+        if (tracer.update_frame()) {
+            if (!first_frame_presented) {
+                first_frame_presented = true;
+                fmt::println("first frame after {:.1f}ms", ms_since(startup));
+            }
+            // the front frame belongs to this thread until the next update_frame, no copy or lock needed
+            const Frame& frame = tracer.frame();
+            if (frame.width == presented_width && frame.height == presented_height) {
+                r.update_image(reinterpret_cast<const u8*>(frame.pixels.data()));
+            } else {
+                r.update_image(reinterpret_cast<u8*>(placeholder.data()));
+            }
+        }
         r.draw_frame();
     }
 
+    tracer.stop();
     r.wait_for_device_idle();
     return 0;
 }
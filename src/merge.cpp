@@ -0,0 +1,106 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ray-tracing/Camera.hpp"
+#include "ray-tracing/Checkpoint.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "utils/BMP.hpp"
+#include "utils/ImageWriter.hpp"
+
+using namespace RayTracer;
+
+/*
+sums the checkpoints of renderer-headless --samples runs into one image. the parts have to share
+the scene, resolution, seed and sampler and cover disjoint sample ranges, together they are then
+the same samples a single process would have taken
+*/
+
+static void print_usage(const char* program) {
+    fmt::println(
+        "usage: {} --output FILE.bmp|FILE.png|FILE.pfm [--exposure X] [--tone-mapping aces|none] PARTIAL...", program
+    );
+}
+
+int main(int argc, char** argv) {
+    std::string output;
+    RenderSettings settings;
+    std::vector<std::string> partials;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--output" && has_value) {
+            output = argv[++i];
+        } else if (arg == "--exposure" && has_value) {
+            settings.exposure = std::stof(argv[++i]);
+        } else if (arg == "--tone-mapping" && has_value) {
+            std::string_view mapping = argv[++i];
+            if (mapping != "aces" && mapping != "none") {
+                print_usage(argv[0]);
+                return 1;
+            }
+            settings.tone_mapping = mapping == "none" ? ToneMapping::NONE : ToneMapping::ACES;
+        } else if (arg.starts_with("--")) {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            partials.emplace_back(arg);
+        }
+    }
+    if (partials.empty() || !image_format(output).has_value()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    CheckpointHeader first = read_checkpoint_header(partials[0]);
+    Camera cam(45.0f, Vec3f(), 0.0f, 0.0f, first.width, first.height);
+    Scene scene(cam);
+    scene.settings.exposure = settings.exposure;
+    scene.settings.tone_mapping = settings.tone_mapping;
+
+    std::vector<std::pair<u32, u32>> ranges;
+    for (const std::string& path : partials) {
+        PartialRender partial = add_checkpoint(path, cam);
+        const CheckpointHeader& header = partial.header;
+        if (header.scene_fingerprint != first.scene_fingerprint || header.seed != first.seed ||
+            header.sampler != first.sampler) {
+            fmt::println("{} was rendered from another scene or with another seed or sampler than {}", path, partials[0]);
+            return 1;
+        }
+        ranges.emplace_back(header.sample_offset, header.sample_offset + partial.max_samples);
+        fmt::println("{}: samples {} to {}", path, ranges.back().first, ranges.back().second);
+    }
+    // a sample index taken twice would count the same path twice
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (ranges[i].first < ranges[i - 1].second) {
+            fmt::println("sample ranges [{}, {}) and [{}, {}) overlap", ranges[i - 1].first, ranges[i - 1].second, ranges[i].first, ranges[i].second);
+            return 1;
+        }
+    }
+
+    bool written = false;
+    switch (*image_format(output)) {
+        case ImageFormat::BMP:
+            scene.resolve_image();
+            written = write_bmp_image(output, cam.image, cam.window_width, cam.window_height);
+            break;
+        case ImageFormat::PNG:
+            scene.resolve_image();
+            written = write_png_image(output, cam.image, cam.window_width, cam.window_height);
+            break;
+        case ImageFormat::PFM:
+            written = write_pfm_image(output, cam.hdr_image(), cam.window_width, cam.window_height);
+            break;
+    }
+    if (!written) {
+        fmt::println("could not write {}", output);
+        return 1;
+    }
+    fmt::println("merged {} partial renders into {}", partials.size(), output);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include <fmt/core.h>
+
+#include <chrono>
+#include <string>
+
+#include "utils/BS_thread_pool.hpp"
+#include "utils/MeshFile.hpp"
+#include "utils/Obj.hpp"
+
+/*
+converts .obj files to the binary .mesh format once so later renders map them instead of
+parsing text. scene files can name the .mesh file wherever they named the .obj
+*/
+int main(int argc, char** argv) {
+    if (argc != 2 && argc != 3) {
+        fmt::println("usage: {} INPUT.obj [OUTPUT.mesh]", argv[0]);
+        return 1;
+    }
+    std::string input = argv[1];
+    std::string output = argc == 3 ? argv[2] : input.substr(0, input.rfind('.')) + ".mesh";
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    BS::thread_pool pool;
+    ParsedObj obj = load_obj(input, pool);
+    clock::time_point parsed = clock::now();
+    write_mesh_file(output, obj);
+    clock::time_point written = clock::now();
+
+    fmt::println(
+        "{} -> {}: {} vertices, {} faces, parsed in {:.1f}ms, written in {:.1f}ms", input, output,
+        obj.vertices.size(), obj.faces.size(), std::chrono::duration<double, std::milli>(parsed - start).count(),
+        std::chrono::duration<double, std::milli>(written - parsed).count()
+    );
+    return 0;
+}
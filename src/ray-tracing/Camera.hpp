@@ -3,29 +3,120 @@
 #include "linear_algebra/Vec3.hpp"
 #include "linear_algebra/Quaternion.hpp"
 #include "utils/MathUtils.hpp"
+#include "utils/Morton.hpp"
+#include <algorithm>
 #include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <ranges>
+#include <utility>
 #include <sys/types.h>
 #include <vector>
 #include <memory>
 
 namespace RayTracer {
 
+// first camera ray intersection of a pixel, the position is rebuilt from t and the camera ray
+struct PrimaryHit {
+    static constexpr u32 EMPTY = std::numeric_limits<u32>::max();
+    static constexpr u32 MISS = std::numeric_limits<u32>::max() - 1;
+
+    f32 t = 0;
+    Vec3<f32> normal;
+    u32 object_index = EMPTY;
+};
+
+struct TileBounds {
+    u32 x_begin;
+    u32 y_begin;
+    u32 x_end;
+    u32 y_end;
+};
+
+// pixels are grouped in square tiles of this size, the unit of scheduling and adaptive sampling
+constexpr u32 CAMERA_TILE_SIZE = 16;
+
+/*
+offset of a pixel in the accumulation buffers. they are stored tile by tile and morton
+ordered inside a tile, so every tile a worker renders is one contiguous block of memory.
+tiles on the right and bottom edge are padded to the full tile size
+*/
+constexpr u32 tiled_index(u32 x, u32 y, u32 tiles_x) {
+    return (x / CAMERA_TILE_SIZE + (y / CAMERA_TILE_SIZE) * tiles_x) * CAMERA_TILE_SIZE * CAMERA_TILE_SIZE +
+           morton_encode(x % CAMERA_TILE_SIZE, y % CAMERA_TILE_SIZE);
+}
+
+// the view and accumulation before a camera move, kept until the scene reprojected it
+struct CameraHistory {
+    bool valid = false;
+    u32 width = 0;
+    u32 height = 0;
+    Vec3<f32> position;
+    Vec3<f32> z_axis;
+    Vec3<f32> right_direction;
+    Vec3<f32> up_direction;
+    std::vector<Vec3<f32>> accumulation_data;
+    std::vector<f32> accumulation_sq_data;
+    std::vector<u32> sample_counts;
+    std::vector<PrimaryHit> primary_hits;
+
+    u32 accumulation_index(u32 x, u32 y) const {
+        return tiled_index(x, y, (width + CAMERA_TILE_SIZE - 1) / CAMERA_TILE_SIZE);
+    }
+
+    Vec3<f32> get_ray(u32 x, u32 y, f32 jitter_x, f32 jitter_y) const {
+        f32 u = (static_cast<f32>(x) + jitter_x) / static_cast<f32>(width) * 2.0f - 1.0f;
+        f32 v = (static_cast<f32>(y) + jitter_y) / static_cast<f32>(height) * 2.0f - 1.0f;
+        return z_axis + Vec3(right_direction).scale(u) + Vec3(up_direction).scale(v);
+    }
+
+    // inverse of get_ray, the continuous pixel coordinates a world position was seen at
+    std::optional<std::pair<f32, f32>> project(const Vec3<f32>& point) const {
+        Vec3<f32> direction = point - position;
+        f32 depth = direction.dot(z_axis);
+        if (depth <= 0.0f) {
+            return std::nullopt;
+        }
+        f32 u = direction.dot(right_direction) / (depth * right_direction.dot(right_direction));
+        f32 v = direction.dot(up_direction) / (depth * up_direction.dot(up_direction));
+        return std::pair((u + 1.0f) * 0.5f * (f32)width, (v + 1.0f) * 0.5f * (f32)height);
+    }
+};
 
 class Camera {
     f32 m_viewport_height = 0;
     f32 m_viewport_width = 0;
     Vec3<f32> m_z_axis;
+    Vec3<f32> m_right_direction;
+    Vec3<f32> m_up_direction;
     Vec3<f32> m_position;
     f32 m_vfov = 0;
 
 public:
     std::vector<Vec4<u8>> image;
     std::vector<Vec3<f32>> ray_directions;
+    // accumulation_data, accumulation_sq_data and sample_counts are tiled, see accumulation_index()
     std::vector<Vec3<f32>> accumulation_data;
+    // sum of squared luminance per pixel, used to estimate the variance for adaptive sampling
+    std::vector<f32> accumulation_sq_data;
+    // pixels stop receiving samples once their tile converged so each one keeps its own count
+    std::vector<u32> sample_counts;
+    std::vector<u8> converged_tiles;
+    // tile indices along a morton curve, the order tiles are handed to the render workers
+    std::vector<u32> tile_order;
+    // primary hit cache, one entry per pixel and jitter pattern, emptied whenever the view changes
+    std::vector<PrimaryHit> primary_hits;
+    CameraHistory history;
+    u32 converged_tiles_count = 0;
     u32 frame_index = 1;
+    // bumped by every reset so the scene can tell the view changed since it last looked
+    u32 reset_count = 0;
     u32 window_width;
     u32 window_height;
+
+    // adaptive sampling granularity in pixels
+    static constexpr u32 TILE_SIZE = CAMERA_TILE_SIZE;
     
     Camera(f32 vfov, Vec3<f32> position, f32 pitch, f32 yaw, u32 w_width, u32 w_height) :  
         m_position(position), m_vfov(vfov)
@@ -43,8 +134,18 @@ public:
         this->window_width = w_width;
         this->window_height = w_height;
         this->image.resize(window_height * window_width);
-        this->accumulation_data.resize(window_height * window_width);
+        this->accumulation_data.resize(accumulation_size());
+        this->accumulation_sq_data.resize(accumulation_size());
+        this->sample_counts.resize(accumulation_size());
+        this->converged_tiles.resize(tiles_x() * tiles_y());
+        this->tile_order.resize(tiles_x() * tiles_y());
+        std::iota(this->tile_order.begin(), this->tile_order.end(), 0);
+        std::sort(this->tile_order.begin(), this->tile_order.end(), [this](u32 a, u32 b) {
+            return morton_encode(a % tiles_x(), a / tiles_x()) < morton_encode(b % tiles_x(), b / tiles_x());
+        });
         this->ray_directions.resize(window_height * window_width);
+        this->primary_hits.clear();
+        this->history = CameraHistory{};
 
         f32 theta = to_radians(m_vfov);
         f32 h = std::tan(theta / 2.0f);
@@ -52,8 +153,60 @@ public:
         f32 viewport_width = viewport_height * (f32)window_width / (f32)window_height;
         m_viewport_height = viewport_height;
         m_viewport_width = viewport_width;
-        memset(this->accumulation_data.data(), 0, this->accumulation_data.size() * sizeof(Vec3<f32>));
-        this->frame_index = 1;
+        reset_accu_data();
+    }
+
+    u32 tiles_x() const {
+        return (window_width + TILE_SIZE - 1) / TILE_SIZE;
+    }
+
+    u32 tiles_y() const {
+        return (window_height + TILE_SIZE - 1) / TILE_SIZE;
+    }
+
+    size_t accumulation_size() const {
+        return (size_t)tiles_x() * tiles_y() * TILE_SIZE * TILE_SIZE;
+    }
+
+    u32 accumulation_index(u32 x, u32 y) const {
+        return tiled_index(x, y, tiles_x());
+    }
+
+    // mean radiance of every pixel in row order, before exposure and tone mapping
+    std::vector<Vec3<f32>> hdr_image() const {
+        std::vector<Vec3<f32>> out((size_t)window_width * window_height);
+        for (u32 y = 0; y < window_height; ++y) {
+            for (u32 x = 0; x < window_width; ++x) {
+                u32 index = accumulation_index(x, y);
+                u32 samples = sample_counts[index];
+                if (samples != 0) {
+                    out[x + (size_t)y * window_width] = accumulation_data[index] / (f32)samples;
+                }
+            }
+        }
+        return out;
+    }
+
+    void resize_primary_hits(u32 patterns) {
+        size_t size = (size_t)window_width * window_height * patterns;
+        if (this->primary_hits.size() != size) {
+            this->primary_hits.assign(size, PrimaryHit{});
+        }
+    }
+
+    u32 tile_index(u32 x, u32 y) const {
+        return x / TILE_SIZE + (y / TILE_SIZE) * tiles_x();
+    }
+
+    TileBounds tile_bounds(u32 tile) const {
+        u32 x_begin = (tile % tiles_x()) * TILE_SIZE;
+        u32 y_begin = (tile / tiles_x()) * TILE_SIZE;
+        return TileBounds{
+            .x_begin = x_begin,
+            .y_begin = y_begin,
+            .x_end = std::min(x_begin + TILE_SIZE, window_width),
+            .y_end = std::min(y_begin + TILE_SIZE, window_height),
+        };
     }
 
     Camera(Camera&) = delete;
@@ -63,6 +216,8 @@ public:
         auto up = Vec3(0.0f, 1.0f, 0.0f);
         auto right_direction = m_z_axis.cross(up).normalize().scale(m_viewport_width / 2.0f);
         auto up_direction = m_z_axis.cross(right_direction).normalize().scale(m_viewport_height / 2.0f);
+        m_right_direction = right_direction;
+        m_up_direction = up_direction;
         for (i32 y = (i32)window_height - 1; y >= 0; y--) {
             f32 v = static_cast<f32>(y) / static_cast<f32>(window_height) * 2.0f - 1.0f;
             for (u32 x = 0; x < window_width; x++) {
@@ -75,33 +230,75 @@ public:
 
 
     void update_x_position(f32 x) {
+        save_history();
         auto up_dir = Vec3(0.0f, 1.0f, 0.0f);
         m_position = m_position + m_z_axis.cross(up_dir).scale(x);
-        reset_accu_data();
+        clear_accu_data();
 
     }
 
     void update_y_position(f32 y) {
+        save_history();
         m_position.y += y;
-        reset_accu_data();
+        clear_accu_data();
     }
     
     void update_z_position(f32 z) {
+        save_history();
         m_position = m_position + Vec3(m_z_axis).scale(z);
-        reset_accu_data();
+        clear_accu_data();
     }
 
     void rotate(f32 pitch_delta_radians, f32 yaw_delta_radians) {
         auto up_dir = Vec3(0.0f, 1.0f, 0.0f);
         auto right_direction = m_z_axis.cross(up_dir).normalize();
         auto up = m_z_axis.cross(right_direction).normalize();
+        save_history();
         m_z_axis.rotate(Quaternion<f32>::angle_axis(-pitch_delta_radians, right_direction).cross(Quaternion<f32>::angle_axis(yaw_delta_radians, up)).normalize());
-        reset_accu_data();
+        clear_accu_data();
     }
 
+    // drops the accumulation and any history, the scene itself changed
     void reset_accu_data() {
+        this->history.valid = false;
+        clear_accu_data();
+    }
+
+    /*
+    moves the accumulation into the history before the view changes, unless the history of an
+    earlier move in the same frame was not reprojected yet. the ray basis is the one the last
+    pass traced with
+    */
+    void save_history() {
+        if (this->history.valid || this->frame_index <= 1) {
+            return;
+        }
+        this->history.valid = true;
+        this->history.width = window_width;
+        this->history.height = window_height;
+        this->history.position = m_position;
+        this->history.z_axis = m_z_axis;
+        this->history.right_direction = m_right_direction;
+        this->history.up_direction = m_up_direction;
+        std::swap(this->history.accumulation_data, this->accumulation_data);
+        std::swap(this->history.accumulation_sq_data, this->accumulation_sq_data);
+        std::swap(this->history.sample_counts, this->sample_counts);
+        std::swap(this->history.primary_hits, this->primary_hits);
+        this->accumulation_data.resize(this->history.accumulation_data.size());
+        this->accumulation_sq_data.resize(this->history.accumulation_sq_data.size());
+        this->sample_counts.resize(this->history.sample_counts.size());
+        this->primary_hits.resize(this->history.primary_hits.size());
+    }
+
+    void clear_accu_data() {
         memset(this->accumulation_data.data(), 0, this->accumulation_data.size() * sizeof(Vec3<f32>));
+        memset(this->accumulation_sq_data.data(), 0, this->accumulation_sq_data.size() * sizeof(f32));
+        memset(this->sample_counts.data(), 0, this->sample_counts.size() * sizeof(u32));
+        memset(this->converged_tiles.data(), 0, this->converged_tiles.size() * sizeof(u8));
+        this->converged_tiles_count = 0;
+        std::fill(this->primary_hits.begin(), this->primary_hits.end(), PrimaryHit{});
         this->frame_index = 1;
+        this->reset_count += 1;
     }
 
 
@@ -109,10 +306,17 @@ public:
         return m_position;
     }
 
-    Vec3<f32> get_ray(u32 x, u32 y) {
+    Vec3<f32> get_ray(u32 x, u32 y) const {
         return this->ray_directions[x + y * window_width];
     }
 
+    // jitter is the sub-pixel offset in [0, 1), (0, 0) matches the cached ray_directions
+    Vec3<f32> get_ray(u32 x, u32 y, f32 jitter_x, f32 jitter_y) const {
+        f32 u = (static_cast<f32>(x) + jitter_x) / static_cast<f32>(window_width) * 2.0f - 1.0f;
+        f32 v = (static_cast<f32>(y) + jitter_y) / static_cast<f32>(window_height) * 2.0f - 1.0f;
+        return m_z_axis + Vec3(m_right_direction).scale(u) + Vec3(m_up_direction).scale(v);
+    }
+
     
 };
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "ray-tracing/Checkpoint.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "utils/MappedFile.hpp"
+#include "utils/Panic.hpp"
+
+namespace RayTracer {
+
+static_assert(sizeof(CheckpointHeader) == 64);
+
+namespace {
+
+struct CheckpointLayout {
+    u64 accumulation_offset;
+    u64 accumulation_sq_offset;
+    u64 sample_counts_offset;
+    u64 converged_tiles_offset;
+    u64 size;
+};
+
+u64 align_up(u64 offset) {
+    return (offset + 63) / 64 * 64;
+}
+
+CheckpointLayout checkpoint_layout(u64 accumulation_size, u64 tile_count) {
+    CheckpointLayout layout;
+    layout.accumulation_offset = align_up(sizeof(CheckpointHeader));
+    layout.accumulation_sq_offset = align_up(layout.accumulation_offset + accumulation_size * sizeof(Vec3<f32>));
+    layout.sample_counts_offset = align_up(layout.accumulation_sq_offset + accumulation_size * sizeof(f32));
+    layout.converged_tiles_offset = align_up(layout.sample_counts_offset + accumulation_size * sizeof(u32));
+    layout.size = layout.converged_tiles_offset + tile_count;
+    return layout;
+}
+
+}  // namespace
+
+u64 checkpoint_fingerprint(std::string_view scene) {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (char c : scene) {
+        hash = (hash ^ (u8)c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool write_checkpoint(std::string_view path, const Camera& camera, const RenderSettings& settings, u64 scene_fingerprint) {
+    CheckpointHeader header;
+    header.width = camera.window_width;
+    header.height = camera.window_height;
+    header.frame_index = camera.frame_index;
+    header.converged_tiles_count = camera.converged_tiles_count;
+    header.seed = settings.seed;
+    header.sampler = (u32)settings.sampler;
+    header.sample_offset = settings.sample_offset;
+    header.scene_fingerprint = scene_fingerprint;
+    header.accumulation_size = camera.accumulation_data.size();
+    header.tile_count = camera.converged_tiles.size();
+    CheckpointLayout layout = checkpoint_layout(header.accumulation_size, header.tile_count);
+
+    std::string temporary = std::string(path) + ".tmp";
+    {
+        MappedFile file(temporary, layout.size);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::byte* out = file.writable_bytes().data();
+        std::memcpy(out, &header, sizeof(header));
+        std::memcpy(out + layout.accumulation_offset, camera.accumulation_data.data(), header.accumulation_size * sizeof(Vec3<f32>));
+        std::memcpy(out + layout.accumulation_sq_offset, camera.accumulation_sq_data.data(), header.accumulation_size * sizeof(f32));
+        std::memcpy(out + layout.sample_counts_offset, camera.sample_counts.data(), header.accumulation_size * sizeof(u32));
+        std::memcpy(out + layout.converged_tiles_offset, camera.converged_tiles.data(), header.tile_count);
+        if (!file.flush()) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, std::string(path), error);
+    return !error;
+}
+
+static CheckpointHeader header_of(const MappedFile& file, std::string_view path) {
+    CheckpointHeader header;
+    if (file.size() < sizeof(header)) {
+        panic("{} is not a checkpoint", path);
+    }
+    std::memcpy(&header, file.bytes().data(), sizeof(header));
+    if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION) {
+        panic("{} is not a version {} checkpoint", path, CHECKPOINT_VERSION);
+    }
+    return header;
+}
+
+static CheckpointHeader read_header(const MappedFile& file, std::string_view path, const Camera& camera) {
+    CheckpointHeader header = header_of(file, path);
+    if (header.width != camera.window_width || header.height != camera.window_height) {
+        panic("checkpoint {} is {}x{}, the render is {}x{}", path, header.width, header.height, camera.window_width, camera.window_height);
+    }
+    CheckpointLayout layout = checkpoint_layout(header.accumulation_size, header.tile_count);
+    if (header.accumulation_size != camera.accumulation_data.size() || header.tile_count != camera.converged_tiles.size() ||
+        file.size() < layout.size) {
+        panic("checkpoint {} is truncated or corrupt", path);
+    }
+    return header;
+}
+
+bool load_checkpoint(std::string_view path, Camera& camera, const RenderSettings& settings, u64 scene_fingerprint) {
+    MappedFile file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    CheckpointHeader header = read_header(file, path, camera);
+    if (header.scene_fingerprint != scene_fingerprint) {
+        panic("checkpoint {} belongs to a different scene", path);
+    }
+    if (header.seed != settings.seed || header.sampler != (u32)settings.sampler ||
+        header.sample_offset != settings.sample_offset) {
+        panic("checkpoint {} was rendered with another seed, sampler or sample range", path);
+    }
+    CheckpointLayout layout = checkpoint_layout(header.accumulation_size, header.tile_count);
+
+    const std::byte* in = file.bytes().data();
+    std::memcpy(static_cast<void*>(camera.accumulation_data.data()), in + layout.accumulation_offset, header.accumulation_size * sizeof(Vec3<f32>));
+    std::memcpy(camera.accumulation_sq_data.data(), in + layout.accumulation_sq_offset, header.accumulation_size * sizeof(f32));
+    std::memcpy(camera.sample_counts.data(), in + layout.sample_counts_offset, header.accumulation_size * sizeof(u32));
+    std::memcpy(camera.converged_tiles.data(), in + layout.converged_tiles_offset, header.tile_count);
+    camera.frame_index = header.frame_index;
+    camera.converged_tiles_count = header.converged_tiles_count;
+    return true;
+}
+
+CheckpointHeader read_checkpoint_header(std::string_view path) {
+    MappedFile file(path);
+    if (!file.is_open()) {
+        panic("could not open checkpoint {}", path);
+    }
+    return header_of(file, path);
+}
+
+PartialRender add_checkpoint(std::string_view path, Camera& camera) {
+    MappedFile file(path);
+    if (!file.is_open()) {
+        panic("could not open checkpoint {}", path);
+    }
+    PartialRender partial{.header = read_header(file, path, camera)};
+    CheckpointLayout layout = checkpoint_layout(partial.header.accumulation_size, partial.header.tile_count);
+    const std::byte* in = file.bytes().data();
+    for (size_t i = 0; i < partial.header.accumulation_size; ++i) {
+        Vec3<f32> accumulation;
+        f32 accumulation_sq;
+        u32 samples;
+        std::memcpy(static_cast<void*>(&accumulation), in + layout.accumulation_offset + i * sizeof(Vec3<f32>), sizeof(Vec3<f32>));
+        std::memcpy(&accumulation_sq, in + layout.accumulation_sq_offset + i * sizeof(f32), sizeof(f32));
+        std::memcpy(&samples, in + layout.sample_counts_offset + i * sizeof(u32), sizeof(u32));
+        camera.accumulation_data[i] += accumulation;
+        camera.accumulation_sq_data[i] += accumulation_sq;
+        camera.sample_counts[i] += samples;
+        partial.max_samples = std::max(partial.max_samples, samples);
+    }
+    return partial;
+}
+
+}  // namespace RayTracer
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include "ray-tracing/Camera.hpp"
+#include "ray-tracing/RenderSettings.hpp"
+#include "utils/types.hpp"
+
+namespace RayTracer {
+
+/*
+snapshot of a render in progress. the sampler is stateless, a pixel's next sample index is its
+sample count and the seed comes from the settings, so the accumulation together with the counts
+is all the random state there is. a checkpoint of a sample range (sample_offset) is also the
+partial result merge-partials sums with the other ranges. layout:
+
+    CheckpointHeader
+    accumulation_data     Vec3<f32>[accumulation_size]
+    accumulation_sq_data  f32[accumulation_size]
+    sample_counts         u32[accumulation_size]
+    converged_tiles       u8[tile_count]
+
+every array starts on a 64 byte boundary, everything is in the tiled order of the camera
+*/
+constexpr std::array<char, 8> CHECKPOINT_MAGIC = {'R', 'T', 'C', 'K', 'P', 'T', '\0', '\0'};
+constexpr u32 CHECKPOINT_VERSION = 2;
+
+struct CheckpointHeader {
+    std::array<char, 8> magic = CHECKPOINT_MAGIC;
+    u32 version = CHECKPOINT_VERSION;
+    u32 width = 0;
+    u32 height = 0;
+    u32 frame_index = 0;
+    u32 converged_tiles_count = 0;
+    u32 seed = 0;
+    u32 sampler = 0;
+    u32 sample_offset = 0;
+    // identifies the scene so a checkpoint is never resumed into a different one
+    u64 scene_fingerprint = 0;
+    u64 accumulation_size = 0;
+    u64 tile_count = 0;
+};
+
+// fnv-1a of whatever identifies the scene, e.g. its file contents and the bounce count
+u64 checkpoint_fingerprint(std::string_view scene);
+
+/*
+writes path + ".tmp" through a memory mapping, flushes it to disk and renames it over path. a
+crash while writing leaves the previous checkpoint untouched. false when the file could not be
+written
+*/
+bool write_checkpoint(std::string_view path, const Camera& camera, const RenderSettings& settings, u64 scene_fingerprint);
+
+/*
+restores the accumulation and frame index of the camera, rendering then continues with the
+next sample of every pixel. false when there is no checkpoint at path, panics when it belongs
+to another scene, resolution, seed, sampler or sample range
+*/
+bool load_checkpoint(std::string_view path, Camera& camera, const RenderSettings& settings, u64 scene_fingerprint);
+
+// panics when the file is missing or not a checkpoint
+CheckpointHeader read_checkpoint_header(std::string_view path);
+
+struct PartialRender {
+    CheckpointHeader header;
+    // samples of the pixel with the most, the range is [sample_offset, sample_offset + max_samples)
+    u32 max_samples = 0;
+};
+
+/*
+adds the accumulation and sample counts of a checkpoint to the camera's, for merging renders of
+disjoint sample ranges. checking that the partials belong together is up to the caller, panics
+when the file is missing or has another resolution
+*/
+PartialRender add_checkpoint(std::string_view path, Camera& camera);
+
+}  // namespace RayTracer
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "linear_algebra/Vec3.hpp"
+#include "ray-tracing/Material.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "ray-tracing/objects.hpp"
+#include "utils/Obj.hpp"
+
+namespace RayTracer {
+
+inline const Vec3f CORNELL_CAMERA_POSITION = Vec3f(0.046539098f, -0.042931885f, 5.7400503f);
+
+constexpr Vec3f u8_color_to_float(Vec3<u8>&& color) {
+    return Vec3f(color.x / 255.0f, color.y / 255.0f, color.z / 255.0f);
+}
+
+// the built in cornell box, expects the .obj files in the working directory
+inline void load_cornell_box(Scene& scene, bool with_cubes = false) {
+    scene.add_object(Mesh(
+        Vec3f(), Material({.type = MaterialType::EMISSIVE, .albedo = Vec3f(1.0f), .emission_power = 2.5f}),
+        load_obj("light.obj")
+    ));
+    if (with_cubes) {
+        scene.add_object(Mesh(
+            Vec3f(),
+            Material({
+                .type = MaterialType::METAL,
+                .albedo = u8_color_to_float(Vec3<u8>(255)),
+                .roughness = 0.0f,
+            }),
+            load_obj("cube1.obj")
+        ));
+        scene.add_object(Mesh(
+            Vec3f(),
+            Material({
+                .type = MaterialType::LAMBERTIAN,
+                .albedo = u8_color_to_float(Vec3<u8>(218, 165, 32)),
+            }),
+            load_obj("cube2.obj")
+        ));
+    }
+    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(1, 0, 0)}), load_obj("left.obj")));
+    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(0, 1, 0)}), load_obj("right.obj")));
+    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(1, 1, 1)}), load_obj("floor.obj")));
+    scene.add_object(Mesh(Vec3f(), Material({.albedo = Vec3f(1, 1, 1)}), load_obj("back.obj")));
+}
+
+}  // namespace RayTracer
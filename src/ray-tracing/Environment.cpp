@@ -0,0 +1,105 @@
+#include "ray-tracing/Environment.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/Image.hpp"
+#include "utils/MathUtils.hpp"
+#include "utils/Panic.hpp"
+
+namespace RayTracer {
+
+EnvironmentLight::EnvironmentLight(std::string_view file_path, f32 intensity) {
+    Image image(file_path);
+    if (image.channels < 3) {
+        panic("environment map {} needs at least 3 channels, got {}", file_path, image.channels);
+    }
+    m_width = (u32)image.width;
+    m_height = (u32)image.height;
+    m_pixels.resize((size_t)m_width * m_height);
+    for (size_t i = 0; i < m_pixels.size(); ++i) {
+        size_t offset = i * (size_t)image.channels;
+        if (image.is_hdr()) {
+            m_pixels[i] = Vec3f(image.hdr_img[offset], image.hdr_img[offset + 1], image.hdr_img[offset + 2]);
+        } else {
+            m_pixels[i] = Vec3f(
+                std::pow(image.img[offset] / 255.0f, 2.2f), std::pow(image.img[offset + 1] / 255.0f, 2.2f),
+                std::pow(image.img[offset + 2] / 255.0f, 2.2f)
+            );
+        }
+        m_pixels[i] = m_pixels[i] * intensity;
+    }
+    build_distribution();
+}
+
+EnvironmentLight::EnvironmentLight(u32 width, u32 height, std::vector<Vec3f> pixels, f32 intensity)
+    : m_width(width), m_height(height), m_pixels(std::move(pixels)) {
+    if (m_pixels.size() != (size_t)m_width * m_height) {
+        panic("environment map has {} pixels, expected {}x{}", m_pixels.size(), m_width, m_height);
+    }
+    for (Vec3f& pixel : m_pixels) {
+        pixel = pixel * intensity;
+    }
+    build_distribution();
+}
+
+void EnvironmentLight::build_distribution() {
+    std::vector<f32> row_weights(m_height);
+    std::vector<f32> weights(m_width);
+    m_conditionals.reserve(m_height);
+    for (u32 row = 0; row < m_height; ++row) {
+        // rows near the poles cover less solid angle
+        f32 sin_theta = std::sin(PI * ((f32)row + 0.5f) / (f32)m_height);
+        for (u32 col = 0; col < m_width; ++col) {
+            const Vec3f& pixel = m_pixels[col + row * m_width];
+            weights[col] = (0.2126f * pixel.x + 0.7152f * pixel.y + 0.0722f * pixel.z) * sin_theta;
+        }
+        m_conditionals.emplace_back(weights);
+        row_weights[row] = m_conditionals.back().total();
+    }
+    m_marginal = AliasTable(row_weights);
+}
+
+// y is up, -z is the center of the map
+std::pair<u32, u32> EnvironmentLight::pixel_from_direction(const Vec3f& direction) const {
+    f32 u = 0.5f + std::atan2(direction.x, -direction.z) * (0.5f * INV_PI);
+    f32 v = std::acos(std::clamp(direction.y, -1.0f, 1.0f)) * INV_PI;
+    u32 col = std::min((u32)(u * (f32)m_width), m_width - 1);
+    u32 row = std::min((u32)(v * (f32)m_height), m_height - 1);
+    return {col, row};
+}
+
+Vec3f EnvironmentLight::eval(const Vec3f& direction) const {
+    auto [col, row] = pixel_from_direction(direction);
+    return m_pixels[col + row * m_width];
+}
+
+f32 EnvironmentLight::pdf(const Vec3f& direction) const {
+    auto [col, row] = pixel_from_direction(direction);
+    f32 sin_theta = std::sqrt(std::max(1.0f - direction.y * direction.y, 0.0f));
+    if (sin_theta == 0.0f) {
+        return 0.0f;
+    }
+    f32 image_pdf = m_marginal.pmf(row) * m_conditionals[row].pmf(col) * (f32)m_width * (f32)m_height;
+    // jacobian of the equirectangular mapping, d(omega) = 2 pi^2 sin(theta) du dv
+    return image_pdf / (2.0f * PI * PI * sin_theta);
+}
+
+std::tuple<Vec3f, Vec3f, f32> EnvironmentLight::sample(Sampler& sampler) const {
+    auto [u_row, u_col] = sampler.get_2d();
+    auto [jitter_u, jitter_v] = sampler.get_2d();
+    u32 row = m_marginal.sample(u_row);
+    u32 col = m_conditionals[row].sample(u_col);
+
+    f32 phi = (((f32)col + jitter_u) / (f32)m_width - 0.5f) * 2.0f * PI;
+    f32 theta = ((f32)row + jitter_v) / (f32)m_height * PI;
+    f32 sin_theta = std::sin(theta);
+    Vec3f direction(sin_theta * std::sin(phi), std::cos(theta), -sin_theta * std::cos(phi));
+    if (sin_theta == 0.0f) {
+        return {direction, Vec3f(0.0f), 0.0f};
+    }
+    f32 image_pdf = m_marginal.pmf(row) * m_conditionals[row].pmf(col) * (f32)m_width * (f32)m_height;
+    return {direction, m_pixels[col + row * m_width], image_pdf / (2.0f * PI * PI * sin_theta)};
+}
+
+}  // namespace RayTracer
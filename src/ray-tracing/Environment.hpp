@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "linear_algebra/Vec3.hpp"
+#include "ray-tracing/Sampler.hpp"
+#include "utils/AliasTable.hpp"
+
+namespace RayTracer {
+
+/*
+equirectangular environment map that lights every ray escaping the scene.
+directions are importance sampled by luminance * sin(theta) through a
+marginal alias table over the rows and a conditional alias table per row
+*/
+class EnvironmentLight {
+    u32 m_width = 0;
+    u32 m_height = 0;
+    std::vector<Vec3f> m_pixels;
+    AliasTable m_marginal;
+    std::vector<AliasTable> m_conditionals;
+
+    void build_distribution();
+    std::pair<u32, u32> pixel_from_direction(const Vec3f& direction) const;
+
+public:
+    // loads .hdr as linear radiance and 8 bit images as gamma 2.2 encoded colors
+    EnvironmentLight(std::string_view file_path, f32 intensity = 1.0f);
+    EnvironmentLight(u32 width, u32 height, std::vector<Vec3f> pixels, f32 intensity = 1.0f);
+
+    Vec3f eval(const Vec3f& direction) const;
+
+    // solid angle pdf of sample() picking direction
+    f32 pdf(const Vec3f& direction) const;
+
+    // direction, radiance and solid angle pdf
+    std::tuple<Vec3f, Vec3f, f32> sample(Sampler& sampler) const;
+};
+
+}  // namespace RayTracer
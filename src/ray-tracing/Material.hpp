@@ -3,6 +3,7 @@
 
 #include "linear_algebra/Vec3.hpp"
 #include "linear_algebra/ONB.hpp"
+#include "ray-tracing/Sampler.hpp"
 #include "utils/MathUtils.hpp"
 #include "utils/Panic.hpp"
 
@@ -71,10 +72,9 @@ public:
     }
 
     std::tuple<Vec3f, Vec3f, f32> sample(
-        u32& seed, const Vec3f& view_vector, const Vec3f& normal_vector
+        Sampler& sampler, const Vec3f& view_vector, const Vec3f& normal_vector
     ) const {
-        f32 r1 = rand_float(seed);
-        f32 r2 = rand_float(seed);
+        auto [r1, r2] = sampler.get_2d();
 
         f32 phi = 2 * PI * r2;
         f32 cos_phi = std::cos(phi);
@@ -91,7 +91,10 @@ public:
             Vec3f half_vector = (light_vector + view_vector).normalize();
             return {light_vector, half_vector, pdf};
         } else {
-            Vec3f Vh = Vec3f(this->alpha * view_vector.x, this->alpha * view_vector.y, view_vector.z).normalize();
+            // the visible normals are sampled around +z, the view has to be in that frame too
+            ONB onb{normal_vector};
+            Vec3f local_view(view_vector.dot(onb.u()), view_vector.dot(onb.v()), view_vector.dot(onb.w()));
+            Vec3f Vh = Vec3f(this->alpha * local_view.x, this->alpha * local_view.y, local_view.z).normalize();
             float z = ((1.0f - r1) * (1.0f + Vh.z)) - Vh.z;
             float sinTheta = std::sqrt(clamp(1.0f - z * z, 0.0f, 1.0f));
             float x = sinTheta * cos_phi;
@@ -99,7 +102,6 @@ public:
 
             // compute halfway direction;
             Vec3f Nh = Vec3f(x, y, z) + Vh;
-            ONB onb{normal_vector};
             Vec3f half_vector =
                 onb.local(Vec3f(this->alpha * Nh.x, this->alpha * Nh.y, std::max(0.0f, Nh.z)).normalize());
 
@@ -108,7 +110,7 @@ public:
             f32 NdotH = half_vector.dot(normal_vector);
             f32 VdotH = half_vector.dot(view_vector);
             f32 NdotV = view_vector.dot(normal_vector);
-            f32 pdf = pdf_ggx(NdotH, NdotV, VdotH);
+            f32 pdf = pdf_ggx(NdotH, NdotV, VdotH) / (4.0f * VdotH);
             return {light_vector, half_vector, pdf};
         }
     }
@@ -148,13 +150,11 @@ public:
         return f + f0 * (1.0f - f);
     }
 
-    inline f32 inv_V1(f32 NdotK) const {
-        return NdotK * std::sqrt(this->alpha2 + (1 - alpha2) * NdotK * NdotK);
-    }
-
+    // height correlated smith visibility, G2 / (4 NoV NoL)
     inline f32 V_SmithGGX(f32 NoV, f32 NoL) const {
-        f32 out = std::max((inv_V1(NoV) * inv_V1(NoL)), 0.1f);
-        return 1.0f / out;
+        f32 GGXV = NoL * std::sqrt(NoV * NoV * (1.0f - this->alpha2) + this->alpha2);
+        f32 GGXL = NoV * std::sqrt(NoL * NoL * (1.0f - this->alpha2) + this->alpha2);
+        return 0.5f / std::max(GGXV + GGXL, 1e-6f);
     }
 
     // NdotL or NdotV
@@ -167,15 +167,17 @@ public:
         return NdotL * INV_PI;
     }
 
+    // density of the sampled half vector, the reflected light direction has 1 / (4 VdotH) of it
     inline f32 pdf_ggx(f32 NdotH, f32 NdotV, f32 VdotH) const {
         return D_GGX(NdotH) * Smith_G1_GGX(NdotV) * VdotH / NdotV;
     }
 
+    // solid angle density of sample() picking the light direction, comparable with light pdfs
     inline f32 pdf(f32 NdotH, f32 NdotL, f32 NdotV, f32 VdotH) const {
         if (this->type == MaterialType::LAMBERTIAN) {
             return pdf_cosine(NdotL);
         } else {
-            return pdf_ggx(NdotH, NdotV, VdotH);
+            return pdf_ggx(NdotH, NdotV, VdotH) / (4.0f * VdotH);
         }
     }
 
@@ -0,0 +1,461 @@
+#include "ray-tracing/RenderFarm.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "utils/TileScheduler.hpp"
+
+namespace RayTracer {
+
+static_assert(sizeof(FarmHello) == 40);
+static_assert(sizeof(Vec3<f32>) == 3 * sizeof(f32));
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+bool send_message(Socket& socket, FarmMessage type, std::span<const std::byte> payload) {
+    FarmMessageHeader header{.type = type, .size = (u32)payload.size()};
+    return socket.send_value(header) && socket.send_all(payload);
+}
+
+template <typename T>
+std::span<const std::byte> bytes_of(const T& value) {
+    return std::as_bytes(std::span(&value, 1));
+}
+
+struct Lease {
+    u32 tile;
+    u32 worker;
+    clock::time_point deadline;
+};
+
+// connected but the hello was not read yet
+struct Greeting {
+    Socket socket;
+    clock::time_point deadline;
+};
+
+struct FarmWorker {
+    Socket socket;
+    u32 threads = 1;
+    // leased tiles that did not come back yet, expired ones included so a hung worker gets no more
+    u32 tiles_out = 0;
+};
+
+class FarmCoordinator {
+    Socket& m_listener;
+    Camera& m_camera;
+    const RenderSettings& m_settings;
+    const FarmSettings& m_farm;
+    FarmStats m_stats;
+    clock::duration m_timeout;
+    // how long a message may take to arrive once its first bytes did, and a hello once connected
+    i32 m_message_timeout_ms;
+    TileScheduler m_scheduler;
+    // one per run of tiles, a closed socket is a free place for the next worker
+    std::vector<FarmWorker> m_workers;
+    std::vector<Greeting> m_greeting;
+    // leases that did not expire, a tile has at most two of them at once
+    std::vector<Lease> m_leases;
+    std::vector<u8> m_tile_leases;
+    std::vector<u8> m_tile_done;
+    u32 m_tiles_left = 0;
+    // where the tiles that already came back are received to
+    std::vector<std::byte> m_discard;
+
+public:
+    FarmCoordinator(Socket& listener, Camera& camera, const RenderSettings& settings, const FarmSettings& farm) :
+        m_listener(listener),
+        m_camera(camera),
+        m_settings(settings),
+        m_farm(farm),
+        m_timeout(std::chrono::duration_cast<clock::duration>(std::chrono::duration<f64>(farm.lease_timeout_seconds))),
+        m_message_timeout_ms((i32)std::min(farm.lease_timeout_seconds * 1000.0, 5000.0)),
+        m_workers(std::max(farm.worker_count, 1u)),
+        m_tile_leases(camera.tile_order.size(), 0),
+        m_tile_done(camera.tile_order.size(), 0),
+        m_tiles_left((u32)camera.tile_order.size()),
+        m_discard(FARM_TILE_MESSAGE_SIZE) {
+        // morton ordered runs keep the tiles of a worker next to each other
+        m_scheduler.reset(camera.tile_order, (u32)m_workers.size());
+    }
+
+    bool run() {
+        clock::time_point last_worker = clock::now();
+        clock::time_point last_report = clock::now();
+        while (m_tiles_left > 0) {
+            expire_leases();
+            expire_greetings();
+            u32 connected = 0;
+            for (u32 worker = 0; worker < m_workers.size(); ++worker) {
+                if (m_workers[worker].socket.is_open()) {
+                    hand_out(worker);
+                    connected += m_workers[worker].socket.is_open();
+                }
+            }
+            if (connected == 0 && clock::now() - last_worker > m_timeout) {
+                fmt::println("no worker connected for {}s, {} tiles left", m_farm.lease_timeout_seconds, m_tiles_left);
+                return false;
+            }
+            if (clock::now() - last_report >= std::chrono::seconds(1)) {
+                last_report = clock::now();
+                fmt::println("{}/{} tiles, {} workers", m_tile_done.size() - m_tiles_left, m_tile_done.size(), connected);
+            }
+            wait_for_messages();
+            // reading from a stalled worker takes up to a message timeout, it was connected until then
+            if (connected > 0) {
+                last_worker = clock::now();
+            }
+        }
+        finish();
+        m_camera.frame_index = m_farm.spp + 1;
+        return true;
+    }
+
+    const FarmStats& stats() const {
+        return m_stats;
+    }
+
+private:
+    void wait_for_messages() {
+        std::vector<const Socket*> sockets = {&m_listener};
+        for (const Greeting& greeting : m_greeting) {
+            sockets.push_back(&greeting.socket);
+        }
+        std::vector<u32> workers;
+        for (u32 worker = 0; worker < m_workers.size(); ++worker) {
+            if (m_workers[worker].socket.is_open()) {
+                sockets.push_back(&m_workers[worker].socket);
+                workers.push_back(worker);
+            }
+        }
+        // wake up for the next lease to expire, and now and then to notice a silent timeout
+        clock::time_point wake = clock::now() + std::chrono::seconds(1);
+        for (const Lease& lease : m_leases) {
+            wake = std::min(wake, lease.deadline);
+        }
+        for (const Greeting& greeting : m_greeting) {
+            wake = std::min(wake, greeting.deadline);
+        }
+        auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(wake - clock::now()).count();
+        std::vector<bool> readable = Socket::wait_readable(sockets, (i32)std::clamp<i64>(timeout_ms, 0, 1000));
+
+        size_t greeting_count = m_greeting.size();
+        for (size_t i = 0; i < workers.size(); ++i) {
+            if (readable[1 + greeting_count + i]) {
+                receive(workers[i]);
+            }
+        }
+        // back to front so erasing keeps the indices of the rest
+        for (size_t i = greeting_count; i-- > 0;) {
+            if (readable[1 + i]) {
+                greet(std::move(m_greeting[i].socket));
+                m_greeting.erase(m_greeting.begin() + (std::ptrdiff_t)i);
+            }
+        }
+        if (readable[0]) {
+            Socket socket = m_listener.accept();
+            if (socket.is_open()) {
+                m_greeting.push_back(Greeting{
+                    .socket = std::move(socket),
+                    .deadline = clock::now() + std::chrono::milliseconds(m_message_timeout_ms),
+                });
+            }
+        }
+    }
+
+    /*
+    workers may still be sending copies of stolen tiles. closing with those unread would reset the
+    connection and could drop DONE before they read it, so this waits for them to hang up first
+    */
+    void finish() {
+        for (FarmWorker& worker : m_workers) {
+            if (worker.socket.is_open()) {
+                send_message(worker.socket, FarmMessage::DONE, {});
+                worker.socket.shutdown_send();
+            }
+        }
+        clock::time_point deadline = clock::now() + std::chrono::milliseconds(m_message_timeout_ms);
+        while (clock::now() < deadline) {
+            std::vector<Socket*> open;
+            for (FarmWorker& worker : m_workers) {
+                if (worker.socket.is_open()) {
+                    open.push_back(&worker.socket);
+                }
+            }
+            if (open.empty()) {
+                return;
+            }
+            auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+            std::vector<const Socket*> sockets(open.begin(), open.end());
+            std::vector<bool> readable = Socket::wait_readable(sockets, (i32)std::clamp<i64>(timeout_ms, 0, 1000));
+            for (size_t i = 0; i < open.size(); ++i) {
+                if (readable[i] && open[i]->receive_some(m_discard) == 0) {
+                    open[i]->close();
+                }
+            }
+        }
+    }
+
+    void greet(Socket socket) {
+        FarmMessageHeader header;
+        FarmHello hello;
+        if (!socket.receive_value(header, m_message_timeout_ms) || header.type != FarmMessage::HELLO ||
+            header.size != sizeof(hello) || !socket.receive_value(hello, m_message_timeout_ms) ||
+            hello.magic != FARM_MAGIC || hello.version != FARM_VERSION) {
+            fmt::println("rejected a worker that does not speak version {} of the farm protocol", FARM_VERSION);
+            m_stats.rejected_workers += 1;
+            return;
+        }
+        if (hello.width != m_camera.window_width || hello.height != m_camera.window_height ||
+            hello.seed != m_settings.seed || hello.sampler != (u32)m_settings.sampler ||
+            hello.scene_fingerprint != m_farm.scene_fingerprint) {
+            fmt::println(
+                "rejected a worker rendering another scene, resolution ({}x{}), seed or sampler", hello.width, hello.height
+            );
+            m_stats.rejected_workers += 1;
+            return;
+        }
+        auto free = std::find_if(m_workers.begin(), m_workers.end(), [](const FarmWorker& worker) {
+            return !worker.socket.is_open();
+        });
+        if (free == m_workers.end()) {
+            fmt::println("rejected a worker, all {} are connected", m_workers.size());
+            m_stats.rejected_workers += 1;
+            return;
+        }
+        *free = FarmWorker{.socket = std::move(socket), .threads = std::max(hello.threads, 1u)};
+        m_stats.workers += 1;
+        fmt::println("worker {} joined with {} threads", free - m_workers.begin(), free->threads);
+    }
+
+    std::optional<u32> next_tile(u32 worker) {
+        while (std::optional<u32> tile = m_scheduler.next(worker)) {
+            // a late copy of an expired lease may have finished a tile that was put back
+            if (!m_tile_done[*tile] && m_tile_leases[*tile] == 0) {
+                return tile;
+            }
+        }
+        // nothing left in any run, lease the oldest unfinished tile still out on a single other worker
+        const Lease* oldest = nullptr;
+        for (const Lease& lease : m_leases) {
+            if (lease.worker != worker && !m_tile_done[lease.tile] && m_tile_leases[lease.tile] == 1 &&
+                (oldest == nullptr || lease.deadline < oldest->deadline)) {
+                oldest = &lease;
+            }
+        }
+        if (oldest == nullptr) {
+            return std::nullopt;
+        }
+        m_stats.stolen_leases += 1;
+        return oldest->tile;
+    }
+
+    // keeps two tiles per thread in flight so a worker never waits for its next lease
+    void hand_out(u32 worker) {
+        FarmWorker& farm_worker = m_workers[worker];
+        while (farm_worker.tiles_out < 2 * farm_worker.threads) {
+            std::optional<u32> tile = next_tile(worker);
+            if (!tile.has_value()) {
+                return;
+            }
+            m_leases.push_back(Lease{.tile = *tile, .worker = worker, .deadline = clock::now() + m_timeout});
+            m_tile_leases[*tile] += 1;
+            farm_worker.tiles_out += 1;
+            FarmLease lease{.tile = *tile, .spp = m_farm.spp};
+            if (!send_message(farm_worker.socket, FarmMessage::LEASE, bytes_of(lease))) {
+                drop(worker);
+                return;
+            }
+        }
+    }
+
+    // removes the live lease of worker on tile, once nobody holds the tile it goes back to a run
+    void release(u32 worker, u32 tile, bool put_back) {
+        auto lease = std::find_if(m_leases.begin(), m_leases.end(), [&](const Lease& lease) {
+            return lease.worker == worker && lease.tile == tile;
+        });
+        if (lease == m_leases.end()) {
+            return;
+        }
+        m_leases.erase(lease);
+        m_tile_leases[tile] -= 1;
+        if (put_back && !m_tile_done[tile] && m_tile_leases[tile] == 0) {
+            m_scheduler.push_back(worker, tile);
+        }
+    }
+
+    void expire_leases() {
+        clock::time_point now = clock::now();
+        std::vector<Lease> expired;
+        for (const Lease& lease : m_leases) {
+            if (lease.deadline <= now) {
+                expired.push_back(lease);
+            }
+        }
+        for (const Lease& lease : expired) {
+            fmt::println("lease of tile {} on worker {} expired", lease.tile, lease.worker);
+            m_stats.expired_leases += 1;
+            release(lease.worker, lease.tile, true);
+        }
+    }
+
+    // peers that connected and did not say hello in time
+    void expire_greetings() {
+        clock::time_point now = clock::now();
+        std::erase_if(m_greeting, [&](const Greeting& greeting) {
+            if (greeting.deadline > now) {
+                return false;
+            }
+            fmt::println("rejected a worker that did not say hello");
+            m_stats.rejected_workers += 1;
+            return true;
+        });
+    }
+
+    void drop(u32 worker) {
+        fmt::println("worker {} disconnected", worker);
+        m_workers[worker].socket.close();
+        m_workers[worker].tiles_out = 0;
+        std::vector<u32> tiles;
+        for (const Lease& lease : m_leases) {
+            if (lease.worker == worker) {
+                tiles.push_back(lease.tile);
+            }
+        }
+        for (u32 tile : tiles) {
+            release(worker, tile, true);
+        }
+    }
+
+    void receive(u32 worker) {
+        Socket& socket = m_workers[worker].socket;
+        FarmMessageHeader header;
+        FarmTile message;
+        if (!socket.receive_value(header, m_message_timeout_ms) || header.type != FarmMessage::TILE ||
+            header.size != FARM_TILE_MESSAGE_SIZE || !socket.receive_value(message, m_message_timeout_ms) ||
+            message.tile >= m_tile_done.size()) {
+            drop(worker);
+            return;
+        }
+        u32 tile = message.tile;
+        bool received = false;
+        if (m_tile_done[tile]) {
+            m_stats.duplicate_tiles += 1;
+            received = socket.receive_all(
+                std::span(m_discard).subspan(0, FARM_TILE_MESSAGE_SIZE - sizeof(FarmTile)), m_message_timeout_ms
+            );
+        } else {
+            // the accumulation is tiled, the pixels of a tile are one block in each buffer. a tile cut
+            // off halfway stays unfinished and is rendered again, overwriting what did arrive
+            size_t begin = (size_t)tile * FARM_TILE_PIXELS;
+            auto receive_block = [&](auto& buffer) {
+                return socket.receive_all(
+                    std::as_writable_bytes(std::span(buffer).subspan(begin, FARM_TILE_PIXELS)), m_message_timeout_ms
+                );
+            };
+            received = receive_block(m_camera.accumulation_data) && receive_block(m_camera.accumulation_sq_data) &&
+                       receive_block(m_camera.sample_counts);
+        }
+        if (!received) {
+            drop(worker);
+            return;
+        }
+        if (!m_tile_done[tile]) {
+            m_tile_done[tile] = 1;
+            m_tiles_left -= 1;
+        }
+        m_workers[worker].tiles_out -= std::min(m_workers[worker].tiles_out, 1u);
+        release(worker, tile, false);
+    }
+};
+
+}  // namespace
+
+bool run_farm_coordinator(
+    Socket& listener, Camera& camera, const RenderSettings& settings, const FarmSettings& farm, FarmStats* stats
+) {
+    FarmCoordinator coordinator(listener, camera, settings, farm);
+    bool complete = coordinator.run();
+    if (stats != nullptr) {
+        *stats = coordinator.stats();
+    }
+    return complete;
+}
+
+bool run_farm_worker(Socket& coordinator, Scene& scene, u32 max_bounces, u64 scene_fingerprint) {
+    Camera& camera = scene.m_camera;
+    FarmHello hello{
+        .width = camera.window_width,
+        .height = camera.window_height,
+        .seed = scene.settings.seed,
+        .sampler = (u32)scene.settings.sampler,
+        .threads = scene.thread_count(),
+        .scene_fingerprint = scene_fingerprint,
+    };
+    if (!send_message(coordinator, FarmMessage::HELLO, bytes_of(hello))) {
+        return false;
+    }
+    const Socket* sockets[] = {&coordinator};
+    std::deque<FarmLease> leases;
+    std::vector<u32> batch;
+    std::vector<std::byte> message(sizeof(FarmMessageHeader) + FARM_TILE_MESSAGE_SIZE);
+    while (true) {
+        // blocks for the first lease, then takes whatever else already arrived
+        bool wait = leases.empty();
+        while (wait || Socket::wait_readable(sockets, 0)[0]) {
+            wait = false;
+            FarmMessageHeader header;
+            if (!coordinator.receive_value(header)) {
+                return false;
+            }
+            if (header.type == FarmMessage::DONE) {
+                return true;
+            }
+            FarmLease lease;
+            if (header.type != FarmMessage::LEASE || header.size != sizeof(lease) || !coordinator.receive_value(lease) ||
+                lease.tile >= camera.tile_order.size()) {
+                return false;
+            }
+            leases.push_back(lease);
+        }
+
+        // a tile per thread, the leases behind them are the next batch
+        u32 spp = leases.front().spp;
+        batch.clear();
+        while (!leases.empty() && batch.size() < scene.thread_count() && leases.front().spp == spp) {
+            batch.push_back(leases.front().tile);
+            leases.pop_front();
+        }
+        scene.render_tiles_to(batch, max_bounces, spp);
+
+        for (u32 tile : batch) {
+            size_t begin = (size_t)tile * FARM_TILE_PIXELS;
+            FarmMessageHeader header{.type = FarmMessage::TILE, .size = FARM_TILE_MESSAGE_SIZE};
+            FarmTile tile_header{.tile = tile};
+            std::byte* out = message.data();
+            auto append = [&out](const void* data, size_t size) {
+                std::memcpy(out, data, size);
+                out += size;
+            };
+            append(&header, sizeof(header));
+            append(&tile_header, sizeof(tile_header));
+            append(&camera.accumulation_data[begin], FARM_TILE_PIXELS * sizeof(Vec3<f32>));
+            append(&camera.accumulation_sq_data[begin], FARM_TILE_PIXELS * sizeof(f32));
+            append(&camera.sample_counts[begin], FARM_TILE_PIXELS * sizeof(u32));
+            if (!coordinator.send_all(message)) {
+                return false;
+            }
+        }
+    }
+}
+
+}  // namespace RayTracer
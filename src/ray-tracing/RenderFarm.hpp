@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+
+#include "ray-tracing/Camera.hpp"
+#include "ray-tracing/RenderSettings.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "utils/Socket.hpp"
+#include "utils/types.hpp"
+
+namespace RayTracer {
+
+/*
+splits a frame by tiles across worker processes. a worker loads the scene once, connects to the
+coordinator and says hello, then renders the tiles it is leased to the full spp and sends each
+one back. the coordinator stitches the tiles into its camera. every message is a FarmMessageHeader
+followed by size bytes:
+
+    HELLO  worker -> coordinator  FarmHello
+    LEASE  coordinator -> worker  FarmLease
+    TILE   worker -> coordinator  FarmTile, then accumulation_data Vec3<f32>[FARM_TILE_PIXELS],
+                                  accumulation_sq_data f32[FARM_TILE_PIXELS], sample_counts u32[FARM_TILE_PIXELS]
+    DONE   coordinator -> worker  nothing, the frame is complete
+
+values are in the byte order of the machines, which have to agree
+*/
+constexpr std::array<char, 8> FARM_MAGIC = {'R', 'T', 'F', 'A', 'R', 'M', '\0', '\0'};
+constexpr u32 FARM_VERSION = 1;
+constexpr u32 FARM_TILE_PIXELS = Camera::TILE_SIZE * Camera::TILE_SIZE;
+
+enum class FarmMessage : u32 {
+    HELLO,
+    LEASE,
+    TILE,
+    DONE,
+};
+
+struct FarmMessageHeader {
+    FarmMessage type;
+    u32 size = 0;
+};
+
+// workers that render another scene, resolution, seed or sampler than the coordinator are dropped
+struct FarmHello {
+    std::array<char, 8> magic = FARM_MAGIC;
+    u32 version = FARM_VERSION;
+    u32 width = 0;
+    u32 height = 0;
+    u32 seed = 0;
+    u32 sampler = 0;
+    // render threads, the coordinator keeps twice as many leases in flight
+    u32 threads = 0;
+    u64 scene_fingerprint = 0;
+};
+
+struct FarmLease {
+    u32 tile = 0;
+    u32 spp = 0;
+};
+
+struct FarmTile {
+    u32 tile = 0;
+    u32 padding = 0;
+};
+
+constexpr u32 FARM_TILE_MESSAGE_SIZE =
+    sizeof(FarmTile) + FARM_TILE_PIXELS * (sizeof(Vec3<f32>) + sizeof(f32) + sizeof(u32));
+
+struct FarmSettings {
+    // the tiles are split into this many runs up front, one per worker that connects
+    u32 worker_count = 1;
+    u32 spp = 1;
+    /*
+    a lease that is not back after this long goes to another worker. also how long the
+    coordinator waits without any worker connected before it gives up
+    */
+    f64 lease_timeout_seconds = 60;
+    // identifies the scene, see checkpoint_fingerprint()
+    u64 scene_fingerprint = 0;
+};
+
+struct FarmStats {
+    u32 workers = 0;
+    u32 rejected_workers = 0;
+    u32 expired_leases = 0;
+    // leases of a tile another worker still holds, handed out once nothing else is left
+    u32 stolen_leases = 0;
+    // tiles that came back more than once, only the first copy is kept
+    u32 duplicate_tiles = 0;
+};
+
+/*
+accepts workers on listener and leases them tiles until every tile of the camera is back. every
+worker starts on its own contiguous run of tiles and steals from the end of the others' runs once
+its own is done. when nothing is left to steal the tiles still out on other workers are leased a
+second time, so a straggler or a hung worker can not hold up the frame, and the first copy to
+come back wins. leases of workers that disconnect or time out go back to the runs, as do those of
+a worker that stops halfway through a message: every message has to arrive within the lease
+timeout, at most 5s, once it started, and a hello within as long after connecting.
+the camera ends up with spp samples in every pixel, exactly the sums render() would have
+accumulated without adaptive sampling. false when no worker was connected for a whole timeout
+*/
+bool run_farm_coordinator(
+    Socket& listener, Camera& camera, const RenderSettings& settings, const FarmSettings& farm, FarmStats* stats = nullptr
+);
+
+/*
+says hello on a connection to the coordinator and renders the tiles it is leased until the frame
+is done. the scene stays loaded the whole time. false when the coordinator rejected the worker
+or went away early
+*/
+bool run_farm_worker(Socket& coordinator, Scene& scene, u32 max_bounces, u64 scene_fingerprint);
+
+}  // namespace RayTracer
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ray-tracing/Sampler.hpp"
+#include "ray-tracing/Tonemap.hpp"
+#include "utils/types.hpp"
+
+namespace RayTracer {
+
+struct RenderSettings {
+    SamplerType sampler = SamplerType::SOBOL;
+
+    // jitters camera rays inside the pixel footprint
+    bool antialiasing = false;
+
+    // reuses the first intersection of every camera ray until the view changes
+    bool primary_hit_cache = true;
+    // with antialiasing the jitter cycles through this many cached patterns per pixel
+    u32 primary_hit_jitter_patterns = 4;
+
+    // decorrelates renders that share the same sample indices
+    u32 seed = 0;
+    // sample index of the first sample of every pixel. processes rendering disjoint ranges of the
+    // same sequence merge into exactly the samples one process would have taken
+    u32 sample_offset = 0;
+
+    // bounces before russian roulette may terminate a path based on its throughput
+    u32 russian_roulette_min_depth = 3;
+
+    // tiles stop sampling once the relative standard error of every pixel falls below this, 0 disables it
+    f32 adaptive_target_error = 0.02f;
+    // samples every pixel takes before its tile can be considered converged
+    u32 adaptive_min_spp = 64;
+
+    // wall time one render call may take, tiles of a pass are spread over several calls when
+    // it is short and several passes are done when it is long. 0 renders exactly one pass
+    f32 frame_budget_ms = 0.0f;
+
+    // after a camera reset the image is first traced at 1 / preview_scale resolution, halved
+    // every frame once the camera stood still for preview_settle_ms. 1 disables the preview
+    u32 preview_scale = 1;
+    f32 preview_settle_ms = 150.0f;
+
+    // carries the accumulation of pixels still visible across camera moves, needs the primary hit cache
+    bool temporal_reprojection = false;
+    // samples a reprojected pixel keeps at most, older view dependent shading fades out faster
+    u32 reprojection_max_history = 32;
+
+    // applied by resolve_image when a frame is presented or written, not per sample
+    f32 exposure = 1.0f;
+    ToneMapping tone_mapping = ToneMapping::ACES;
+};
+
+}  // namespace RayTracer
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "linear_algebra/Vec4.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "utils/MessageQueue.hpp"
+#include "utils/TripleBuffer.hpp"
+
+namespace RayTracer {
+
+struct Frame {
+    std::vector<Vec4<u8>> pixels;
+    u32 width = 0;
+    u32 height = 0;
+    u32 frame_index = 0;
+};
+
+/*
+runs the path tracer on its own thread so presenting and input never wait for a pass.
+anything touching the scene or camera from another thread has to go through commands,
+they run between passes on the render thread. advancing the scene epoch after posting an
+edit has the running pass abandoned at the next tile instead of finishing first
+*/
+class RenderThread {
+    Scene& m_scene;
+    u32 m_max_bounces;
+    u32 m_max_spp;
+
+    TripleBuffer<Frame> m_frames;
+
+    std::atomic<bool> m_running = false;
+    std::atomic<bool> m_finished = false;
+    std::thread m_thread;
+
+    void run() {
+        while (m_running) {
+            // taken before draining so an edit that arrives after the drain still cancels the next pass
+            u64 frame_epoch = m_scene.epoch.current();
+            for (std::function<void()>& command : commands.drain()) {
+                command();
+            }
+            if (m_scene.m_camera.frame_index < m_max_spp && !m_scene.converged()) {
+                m_finished = false;
+                if (m_scene.render(m_max_bounces, frame_epoch, m_max_spp)) {
+                    publish();
+                }
+            } else {
+                m_finished = true;
+                commands.wait_for(std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    void publish() {
+        m_scene.resolve_image();
+        Frame& frame = m_frames.back();
+        frame.pixels = m_scene.m_camera.image;
+        frame.width = m_scene.m_camera.window_width;
+        frame.height = m_scene.m_camera.window_height;
+        frame.frame_index = m_scene.m_camera.frame_index;
+        m_frames.publish();
+    }
+
+public:
+    MessageQueue<std::function<void()>> commands;
+
+    RenderThread(Scene& scene, u32 max_bounces, u32 max_spp)
+        : m_scene(scene), m_max_bounces(max_bounces), m_max_spp(max_spp) {}
+
+    RenderThread(RenderThread&) = delete;
+    RenderThread& operator=(RenderThread&) = delete;
+
+    ~RenderThread() {
+        stop();
+    }
+
+    void start() {
+        m_running = true;
+        m_thread = std::thread(&RenderThread::run, this);
+    }
+
+    // finishes the running pass and joins the thread
+    void stop() {
+        m_running = false;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    // blocks until every command posted before this call ran
+    void sync() {
+        std::promise<void> done;
+        std::future<void> future = done.get_future();
+        commands.push([&done] {
+            done.set_value();
+        });
+        future.wait();
+    }
+
+    // presenter side: makes the latest completed pass current, false when there was none since the last call
+    bool update_frame() {
+        return m_frames.update();
+    }
+
+    // stays untouched by the render thread until the next update_frame()
+    const Frame& frame() const {
+        return m_frames.front();
+    }
+
+    // the target spp was reached or every tile converged
+    bool finished() const {
+        return m_finished;
+    }
+};
+
+}  // namespace RayTracer
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <utility>
+
+#include "utils/MathUtils.hpp"
+#include "utils/types.hpp"
+
+namespace RayTracer {
+
+enum class SamplerType {
+    // independent pcg hashed random numbers
+    UNIFORM,
+    // Owen-scrambled Sobol (0,2)-sequence, padded per dimension pair
+    SOBOL,
+};
+
+namespace sobol {
+
+// direction numbers of the first two Sobol dimensions (van der Corput and x^2 + x + 1)
+constexpr std::array<u32, 32> make_directions(u32 dimension) {
+    std::array<u32, 32> directions{};
+    for (u32 bit = 0; bit < 32; ++bit) {
+        if (dimension == 0) {
+            directions[bit] = 1u << (31 - bit);
+        } else if (bit == 0) {
+            directions[bit] = 1u << 31;
+        } else {
+            directions[bit] = directions[bit - 1] ^ (directions[bit - 1] >> 1);
+        }
+    }
+    return directions;
+}
+
+constexpr std::array<std::array<u32, 32>, 2> DIRECTIONS = {make_directions(0), make_directions(1)};
+
+constexpr u32 sample(u32 index, u32 dimension) {
+    u32 out = 0;
+    for (u32 bit = 0; index != 0; ++bit, index >>= 1) {
+        if (index & 1) {
+            out ^= DIRECTIONS[dimension][bit];
+        }
+    }
+    return out;
+}
+
+constexpr u32 reverse_bits(u32 x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// https://psychopath.io/post/2021_01_30_building_a_better_lk_hash
+constexpr u32 laine_karras_permutation(u32 x, u32 seed) {
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+// Burley 2020, "Practical Hash-based Owen Scrambling"
+constexpr u32 nested_uniform_scramble(u32 x, u32 seed) {
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+}  // namespace sobol
+
+inline u32 hash_combine(u32 seed, u32 value) {
+    return seed ^ (pcg_hash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// maps the top 24 bits to a float in [0, 1)
+constexpr f32 u32_to_unit_float(u32 x) {
+    return (f32)(x >> 8) * 0x1p-24f;
+}
+
+/*
+stateless per pixel/sample sampler, every call draws the next dimension.
+the same (pixel, sample, dimension) always returns the same number which keeps
+renders reproducible and lets sample ranges be split across threads
+*/
+class Sampler {
+    SamplerType m_type;
+    u32 m_pixel_seed;
+    u32 m_sample_index;
+    u32 m_dimension = 0;
+
+public:
+    Sampler(SamplerType type, u32 pixel_index, u32 sample_index, u32 seed = 0)
+        : m_type(type), m_pixel_seed(hash_combine(pcg_hash(seed), pixel_index)), m_sample_index(sample_index) {}
+
+    f32 get_1d() {
+        u32 dimension_seed = hash_combine(m_pixel_seed, m_dimension++);
+        if (m_type == SamplerType::UNIFORM) {
+            return u32_to_unit_float(pcg_hash(hash_combine(dimension_seed, m_sample_index)));
+        }
+        u32 index = sobol::nested_uniform_scramble(m_sample_index, dimension_seed);
+        return u32_to_unit_float(sobol::nested_uniform_scramble(sobol::sample(index, 0), pcg_hash(dimension_seed)));
+    }
+
+    std::pair<f32, f32> get_2d() {
+        u32 dimension_seed = hash_combine(m_pixel_seed, m_dimension);
+        m_dimension += 2;
+        if (m_type == SamplerType::UNIFORM) {
+            return {
+                u32_to_unit_float(pcg_hash(hash_combine(dimension_seed, m_sample_index))),
+                u32_to_unit_float(pcg_hash(hash_combine(dimension_seed + 1, m_sample_index))),
+            };
+        }
+        // both dimensions share the shuffled index so the pair stays a (0,2)-sequence
+        u32 index = sobol::nested_uniform_scramble(m_sample_index, dimension_seed);
+        return {
+            u32_to_unit_float(sobol::nested_uniform_scramble(sobol::sample(index, 0), pcg_hash(dimension_seed))),
+            u32_to_unit_float(sobol::nested_uniform_scramble(sobol::sample(index, 1), pcg_hash(dimension_seed + 1))),
+        };
+    }
+
+    u32 sample_index() const {
+        return m_sample_index;
+    }
+};
+
+}  // namespace RayTracer
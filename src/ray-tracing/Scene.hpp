@@ -3,7 +3,10 @@
 #include <fmt/core.h>
 #include <math.h>
 
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <chrono>
 #include <cmath>
 #include <exception>
 #include <functional>
@@ -12,6 +15,7 @@
 #include <memory>
 #include <numbers>
 #include <optional>
+#include <span>
 #include <system_error>
 #include <thread>
 #include <tuple>
@@ -24,11 +28,18 @@
 #include "linear_algebra/Vec3.hpp"
 #include "linear_algebra/Vec4.hpp"
 #include "ray-tracing/Camera.hpp"
+#include "ray-tracing/Environment.hpp"
 #include "ray-tracing/Material.hpp"
 #include "ray-tracing/Ray.hpp"
+#include "ray-tracing/RenderSettings.hpp"
+#include "ray-tracing/Sampler.hpp"
+#include "ray-tracing/Tonemap.hpp"
 #include "ray-tracing/objects.hpp"
 #include "utils/BS_thread_pool.hpp"
+#include "utils/FrameEpoch.hpp"
+#include "utils/Morton.hpp"
 #include "utils/Panic.hpp"
+#include "utils/TileScheduler.hpp"
 #include "utils/types.hpp"
 
 #define CHECK_NAN(number)       \
@@ -38,13 +49,44 @@
 
 namespace RayTracer {
 
+inline f32 luminance(const Vec3f& color) {
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// Veach's power heuristic with beta = 2
+inline f32 power_heuristic(f32 pdf, f32 other_pdf) {
+    f32 pdf2 = pdf * pdf;
+    f32 other_pdf2 = other_pdf * other_pdf;
+    return pdf2 + other_pdf2 > 0.0f ? pdf2 / (pdf2 + other_pdf2) : 0.0f;
+}
+
 class Scene {
     ObjectsList m_objects;
+    std::optional<EnvironmentLight> m_environment;
+    // long lived workers shared by every frame, 0 threads means one per hardware thread
+    BS::thread_pool m_thread_pool;
+    TileScheduler m_scheduler;
+    // tiles of the running pass, the ones before the cursor already got their sample
+    std::vector<u32> m_active_tiles;
+    size_t m_pass_cursor = 0;
+    u32 m_pass_frame_index = 0;
+    size_t m_pass_tile_count = 0;
+    // smoothed wall time of one tile on all workers, sizes the steps of a frame budget
+    f32 m_ms_per_tile = 0.0f;
+    // reduced resolution the preview is at, 1 once full resolution accumulation took over
+    u32 m_preview_scale = 1;
+    u32 m_seen_reset_count = 0;
+    std::chrono::steady_clock::time_point m_last_reset;
+    // reset count of the camera the rays of render_tiles_to() were set up for
+    std::optional<u32> m_tiles_reset_count;
 
 public:
     Camera& m_camera;
+    RenderSettings settings;
+    // advanced by edits that make the running frame stale
+    FrameEpoch epoch;
 
-    Scene(Camera& camera) : m_camera(camera) {}
+    Scene(Camera& camera, u32 thread_count = 0) : m_thread_pool(thread_count), m_camera(camera) {}
 
     Scene(Scene&) = delete;
     Scene& operator=(Scene&) = delete;
@@ -59,83 +101,482 @@ public:
         return m_objects.get_object<T>(index);
     }
 
-    Vec3f per_pixel(u32 x, u32 y, u32 max_bounces) const {
-        u32 seed = x + y * m_camera.window_width + (m_camera.frame_index << 16);
+    u32 thread_count() const {
+        return m_thread_pool.get_thread_count();
+    }
+
+    // waits for the running frame, then respawns the workers
+    void set_thread_count(u32 thread_count) {
+        m_thread_pool.reset(thread_count);
+    }
+
+    // rays leaving the scene pick up light from the environment instead of black
+    void set_environment(EnvironmentLight&& environment) {
+        m_environment.emplace(std::move(environment));
+    }
+
+    Vec3f environment_light(const Vec3f& direction) const {
+        return m_environment.has_value() ? m_environment->eval(direction) : Vec3f(0.0f);
+    }
+
+    // next event estimation towards the environment, weighted against bsdf sampling
+    Vec3f sample_environment(Sampler& sampler, const HitPayload& payload, const Vec3f& view_vector) const {
+        auto [light_vector, radiance, light_pdf] = m_environment->sample(sampler);
+        f32 NdotL = payload.normal.dot(light_vector);
+        f32 NdotV = payload.normal.dot(view_vector);
+        if (light_pdf <= 0.0f || NdotL <= 0.0f || NdotV <= 0.0f) {
+            return Vec3f(0.0f);
+        }
+        Ray shadow_ray = Ray{.origin = payload.hit_position, .direction = light_vector};
+        if (this->m_objects.any_hit(shadow_ray, 0.001f, std::numeric_limits<f32>::max()).has_value()) {
+            return Vec3f(0.0f);
+        }
+        Vec3f half_vector = (light_vector + view_vector).normalize();
+        f32 NdotH = payload.normal.dot(half_vector);
+        f32 LdotH = light_vector.dot(half_vector);
+        f32 bsdf_pdf = payload.material.pdf(NdotH, NdotL, NdotV, view_vector.dot(half_vector));
+        f32 weight = power_heuristic(light_pdf, bsdf_pdf);
+        return payload.material.brdf(NdotV, NdotH, LdotH, NdotL) * radiance * (NdotL * weight / light_pdf);
+    }
+
+    Vec3f per_pixel(u32 x, u32 y, u32 sample_index, u32 max_bounces) const {
+        Sampler sampler(settings.sampler, x + y * m_camera.window_width, sample_index, settings.seed);
         Vec3f light{0.0f};
-        Ray ray = Ray{.origin = m_camera.position(), .direction = m_camera.get_ray(x, y)};
         Vec3f contribution = Vec3f(1.0f);
-        Mesh light_mesh = m_objects.get_object<Mesh>(0);
+        Ray ray = Ray{.origin = m_camera.position(), .direction = m_camera.get_ray(x, y)};
+        std::optional<HitPayload> payload = primary_hit(x, y, sample_index, sampler, ray);
+        if (!payload.has_value()) {
+            return environment_light(ray.direction);
+        }
+        if (payload->material.get_emission() != Vec3f(0.0f)) {
+            return payload->material.get_emission();
+        }
 
         for (u32 bounce = 0; bounce < max_bounces; ++bounce) {
-            u32 seed = x + y * m_camera.window_width + (m_camera.frame_index << 16);
-            Vec3f light{0.0f};
-            Ray ray = Ray{.origin = m_camera.position(), .direction = m_camera.get_ray(x, y)};
-            Vec3f contribution = Vec3f(1.0f);
-            Mesh light_mesh = m_objects.get_object<Mesh>(0);
-            std::optional<HitPayload> payload =
-                this->m_objects.closest_hit(ray, 0.001f, std::numeric_limits<f32>::max());
+            Vec3f view_vector = -ray.direction;
+            f32 NdotV = payload->normal.dot(view_vector);
+            if (m_environment.has_value()) {
+                light += contribution * sample_environment(sampler, *payload, view_vector);
+            }
+            auto [light_vector, half_vector, pdf] = payload->material.sample(sampler, view_vector, payload->normal);
+            f32 NdotL = payload->normal.dot(light_vector);
+            if (NdotL <= 0) {
+                break;
+            }
+            f32 NdotH = payload->normal.dot(half_vector);
+            f32 LdotH = light_vector.dot(half_vector);
+
+            contribution *= payload->material.brdf(NdotV, NdotH, LdotH, NdotL) * NdotL / pdf;
+
+            if (bounce >= settings.russian_roulette_min_depth) {
+                // survivors are scaled up by 1 / survival so the estimate stays unbiased
+                f32 survival = std::min(std::max({contribution.x, contribution.y, contribution.z}), 0.95f);
+                if (sampler.get_1d() >= survival) {
+                    break;
+                }
+                contribution = contribution / survival;
+            }
+
+            ray.origin = payload->hit_position;
+            ray.direction = light_vector;
+
+            payload = this->m_objects.closest_hit(ray, 0.001f, std::numeric_limits<f32>::max());
             if (!payload.has_value()) {
-                return light;
+                if (m_environment.has_value()) {
+                    f32 weight = power_heuristic(pdf, m_environment->pdf(ray.direction));
+                    light += contribution * m_environment->eval(ray.direction) * weight;
+                }
+                break;
             }
+            light += payload->material.get_emission() * contribution;
             if (payload->material.get_emission() != Vec3f(0.0f)) {
-                return payload->material.get_emission();
+                break;
+            }
+        }
+        return light;
+    }
+
+    // jitters the camera ray when antialiasing and returns its first hit, from the cache when possible
+    std::optional<HitPayload> primary_hit(u32 x, u32 y, u32 sample_index, Sampler& sampler, Ray& ray) const {
+        u32 pixel_index = x + y * m_camera.window_width;
+        u32 patterns = primary_hit_patterns();
+        if (settings.antialiasing) {
+            std::pair<f32, f32> jitter = sampler.get_2d();
+            if (settings.primary_hit_cache) {
+                jitter = Sampler(settings.sampler, pixel_index, sample_index % patterns, settings.seed).get_2d();
             }
+            ray.direction = m_camera.get_ray(x, y, jitter.first, jitter.second);
+        }
 
-            for (u32 bounce = 0; bounce < max_bounces; ++bounce) {
-                Vec3f view_vector = -ray.direction;
-                f32 NdotV = payload->normal.dot(view_vector);
-                {
-                    auto [light_vector, half_vector, pdf] = payload->material.sample(seed, view_vector, payload->normal);
-                    f32 NdotL = payload->normal.dot(light_vector);
-                    if (NdotL <= 0) {
-                        break;
+        if (!settings.primary_hit_cache) {
+            return this->m_objects.closest_hit(ray, 0.001f, std::numeric_limits<f32>::max());
+        }
+
+        PrimaryHit& cached = m_camera.primary_hits[(size_t)pixel_index * patterns + sample_index % patterns];
+        if (cached.object_index == PrimaryHit::EMPTY) {
+            std::optional<HitPayload> payload =
+                this->m_objects.closest_hit(ray, 0.001f, std::numeric_limits<f32>::max());
+            if (payload.has_value()) {
+                cached = PrimaryHit{.t = payload->t, .normal = payload->normal, .object_index = payload->object_index};
+            } else {
+                cached.object_index = PrimaryHit::MISS;
+            }
+            return payload;
+        }
+        if (cached.object_index == PrimaryHit::MISS) {
+            return std::nullopt;
+        }
+        return HitPayload{
+            .hit_position = ray.origin + ray.direction * cached.t,
+            .normal = cached.normal,
+            .t = cached.t,
+            .material = this->m_objects.material(cached.object_index),
+            .object_index = cached.object_index,
+        };
+    }
+
+    u32 primary_hit_patterns() const {
+        return settings.antialiasing ? std::max(settings.primary_hit_jitter_patterns, 1u) : 1;
+    }
+
+    bool render(u32 max_bounces) {
+        return render(max_bounces, epoch.current());
+    }
+
+    /*
+    without a frame budget this is one sample for every active pixel. with one it renders tiles
+    until the budget is spent, a pass can span several calls and several passes can fit in one,
+    the tile count of every step comes from the measured time per tile. passes do not continue
+    past max_spp.
+    returns false when the frame was abandoned because frame_epoch went stale, the tiles
+    finished until then keep their samples since every pixel tracks its own sample count
+    */
+    bool render(u32 max_bounces, u64 frame_epoch, u32 max_spp = std::numeric_limits<u32>::max()) {
+        using clock = std::chrono::steady_clock;
+        clock::time_point start = clock::now();
+        if (m_seen_reset_count != m_camera.reset_count) {
+            m_seen_reset_count = m_camera.reset_count;
+            m_preview_scale = std::max(std::bit_floor(settings.preview_scale), 1u);
+            m_last_reset = start;
+            bool reprojected = true;
+            if (m_camera.history.valid && settings.temporal_reprojection && settings.primary_hit_cache) {
+                // the reprojected image is better than any preview
+                m_preview_scale = 1;
+                reprojected = reproject_history(frame_epoch);
+            }
+            // spent even when abandoned, the next move could not save its own history over a valid one
+            m_camera.history.valid = false;
+            if (!reprojected) {
+                return false;
+            }
+        }
+        if (m_preview_scale > 1) {
+            return render_preview(max_bounces, frame_epoch);
+        }
+        f32 budget_ms = settings.frame_budget_ms;
+        // a resize or reset between calls leaves the old pass pointing at the wrong tiles
+        if (m_pass_frame_index != m_camera.frame_index || m_pass_tile_count != m_camera.tile_order.size()) {
+            m_pass_cursor = m_active_tiles.size();
+        }
+        do {
+            if (m_pass_cursor == m_active_tiles.size()) {
+                begin_pass();
+            }
+            u32 workers = thread_count();
+            size_t remaining = m_active_tiles.size() - m_pass_cursor;
+            size_t count = remaining;
+            if (budget_ms > 0.0f && m_ms_per_tile > 0.0f) {
+                f32 left_ms = budget_ms - std::chrono::duration<f32, std::milli>(clock::now() - start).count();
+                count = std::clamp((size_t)(std::max(left_ms, 0.0f) / m_ms_per_tile), std::min((size_t)workers, remaining), remaining);
+            } else if (budget_ms > 0.0f) {
+                // nothing measured yet, one tile per worker gives the first estimate
+                count = std::min((size_t)workers, remaining);
+            }
+
+            clock::time_point step_start = clock::now();
+            render_tiles(std::span<const u32>(m_active_tiles).subspan(m_pass_cursor, count), max_bounces, frame_epoch);
+            if (epoch.is_stale(frame_epoch)) {
+                m_pass_cursor = m_active_tiles.size();
+                return false;
+            }
+            if (count > 0) {
+                f32 step_ms = std::chrono::duration<f32, std::milli>(clock::now() - step_start).count() / (f32)count;
+                m_ms_per_tile = m_ms_per_tile > 0.0f ? 0.75f * m_ms_per_tile + 0.25f * step_ms : step_ms;
+            }
+            m_pass_cursor += count;
+            if (m_pass_cursor == m_active_tiles.size()) {
+                end_pass();
+            }
+        } while (budget_ms > 0.0f && std::chrono::duration<f32, std::milli>(clock::now() - start).count() < budget_ms &&
+                 !converged() && m_camera.frame_index < max_spp);
+        return true;
+    }
+
+    // resolution divisor of the next frame, 1 when accumulating at full resolution
+    u32 preview_scale() const {
+        return m_preview_scale;
+    }
+
+    // tiles the last pass started with that still have to be rendered
+    size_t pass_tiles_left() const {
+        return m_active_tiles.size() - m_pass_cursor;
+    }
+
+    void render_tile(u32 tile, u32 max_bounces) {
+        TileBounds bounds = m_camera.tile_bounds(tile);
+        for (u32 y = bounds.y_begin; y < bounds.y_end; ++y) {
+            for (u32 x = bounds.x_begin; x < bounds.x_end; ++x) {
+                u32 index = m_camera.accumulation_index(x, y);
+                Vec3f color = per_pixel(x, y, settings.sample_offset + m_camera.sample_counts[index], max_bounces);
+                f32 color_luminance = luminance(color);
+                m_camera.accumulation_data[index] += color;
+                m_camera.accumulation_sq_data[index] += color_luminance * color_luminance;
+                m_camera.sample_counts[index] += 1;
+            }
+        }
+    }
+
+    /*
+    renders the tiles until every pixel in them has spp samples, tile after tile instead of pass
+    after pass. a pixel still takes its samples in index order so the sums match render(), for
+    callers that hand out tiles themselves like the render farm workers
+    */
+    void render_tiles_to(std::span<const u32> tiles, u32 max_bounces, u32 spp) {
+        if (m_tiles_reset_count != m_camera.reset_count) {
+            m_tiles_reset_count = m_camera.reset_count;
+            m_camera.calculate_ray_directions();
+            if (settings.primary_hit_cache) {
+                m_camera.resize_primary_hits(primary_hit_patterns());
+            }
+        }
+        u32 workers = thread_count();
+        m_scheduler.reset(tiles, workers);
+        for (u32 worker = 0; worker < workers; ++worker) {
+            m_thread_pool.push_task([this, worker, max_bounces, spp] {
+                while (std::optional<u32> tile = m_scheduler.next(worker)) {
+                    // the first pixel of a tile is never padding
+                    size_t first_pixel = (size_t)*tile * Camera::TILE_SIZE * Camera::TILE_SIZE;
+                    while (m_camera.sample_counts[first_pixel] < spp) {
+                        render_tile(*tile, max_bounces);
                     }
-                    f32 NdotH = payload->normal.dot(half_vector);
-                    f32 LdotH = light_vector.dot(half_vector);
+                }
+            });
+        }
+        m_thread_pool.wait_for_tasks();
+    }
 
-                    f32 mis_pdf = pdf;
+    /*
+    tonemaps the accumulation into the linear image, only run when a frame is presented or
+    written. pixels without samples keep what is in the image, e.g. the preview
+    */
+    void resolve_image() {
+        constexpr u32 tile_pixels = Camera::TILE_SIZE * Camera::TILE_SIZE;
+        static_assert(tile_pixels <= TONEMAP_BLOCK_SIZE);
+        u32 tile_count = m_camera.tiles_x() * m_camera.tiles_y();
+        m_thread_pool.push_loop(tile_count, [this](const u32 a, const u32 b) {
+            std::array<Vec4<u8>, tile_pixels> block;
+            for (u32 tile = a; tile < b; ++tile) {
+                size_t begin = (size_t)tile * tile_pixels;
+                tonemap_block(
+                    &m_camera.accumulation_data[begin], &m_camera.sample_counts[begin], tile_pixels, settings.exposure,
+                    settings.tone_mapping, block.data()
+                );
+                TileBounds bounds = m_camera.tile_bounds(tile);
+                for (u32 i = 0; i < tile_pixels; ++i) {
+                    u32 x = bounds.x_begin + morton_decode_x(i);
+                    u32 y = bounds.y_begin + morton_decode_y(i);
+                    if (x < bounds.x_end && y < bounds.y_end && m_camera.sample_counts[begin + i] != 0) {
+                        m_camera.image[x + y * m_camera.window_width] = block[i];
+                    }
+                }
+            }
+        });
+        m_thread_pool.wait_for_tasks();
+    }
 
-                    contribution *= payload->material.brdf(NdotV, NdotH, LdotH, NdotL) * NdotL / mis_pdf;
+    // true once adaptive sampling stopped every tile
+    bool converged() const {
+        return m_camera.converged_tiles_count == m_camera.converged_tiles.size();
+    }
 
-                    ray.origin = payload->hit_position;
-                    ray.direction = light_vector;
+    // relative standard error of the mean luminance of a pixel, index is its accumulation_index()
+    f32 pixel_error(u32 index) const {
+        u32 n = m_camera.sample_counts[index];
+        if (n < 2) {
+            return std::numeric_limits<f32>::max();
+        }
+        f32 mean = luminance(m_camera.accumulation_data[index]) / (f32)n;
+        f32 variance = std::max(m_camera.accumulation_sq_data[index] / (f32)n - mean * mean, 0.0f) * (f32)n / (f32)(n - 1);
+        // the offset keeps near black pixels from demanding an absurd number of samples
+        return std::sqrt(variance / (f32)n) / (mean + 0.01f);
+    }
 
-                    payload = this->m_objects.closest_hit(ray, 0.001f, std::numeric_limits<f32>::max());
+private:
+    /*
+    one sample through the center of every preview_scale sized block, written over the whole
+    block of the image. nothing is accumulated, full resolution starts from zero samples
+    */
+    bool render_preview(u32 max_bounces, u64 frame_epoch) {
+        this->m_camera.calculate_ray_directions();
+        if (settings.primary_hit_cache) {
+            this->m_camera.resize_primary_hits(primary_hit_patterns());
+        }
+        u32 scale = m_preview_scale;
+        u32 blocks_x = (m_camera.window_width + scale - 1) / scale;
+        u32 blocks_y = (m_camera.window_height + scale - 1) / scale;
+        m_thread_pool.push_loop(blocks_y, [this, scale, blocks_x, max_bounces, frame_epoch](const u32 a, const u32 b) {
+            for (u32 block_y = a; block_y < b && !epoch.is_stale(frame_epoch); ++block_y) {
+                u32 y_begin = block_y * scale;
+                u32 y_end = std::min(y_begin + scale, m_camera.window_height);
+                for (u32 block_x = 0; block_x < blocks_x; ++block_x) {
+                    u32 x_begin = block_x * scale;
+                    u32 x_end = std::min(x_begin + scale, m_camera.window_width);
+                    Vec4<u8> color = tonemap_pixel(
+                        per_pixel((x_begin + x_end) / 2, (y_begin + y_end) / 2, 0, max_bounces), settings.exposure,
+                        settings.tone_mapping
+                    );
+                    for (u32 y = y_begin; y < y_end; ++y) {
+                        std::fill_n(m_camera.image.begin() + x_begin + y * m_camera.window_width, x_end - x_begin, color);
+                    }
+                }
+            }
+        });
+        m_thread_pool.wait_for_tasks();
+        if (epoch.is_stale(frame_epoch)) {
+            return false;
+        }
+        f32 still_ms = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - m_last_reset).count();
+        if (still_ms >= settings.preview_settle_ms) {
+            m_preview_scale /= 2;
+        }
+        return true;
+    }
+
+    /*
+    gathers the history of every pixel whose primary hit was seen by the previous view. the hit
+    has to land on the same object with a similar normal and depth, anything else was
+    disoccluded and starts from zero. returns false when frame_epoch went stale
+    */
+    bool reproject_history(u64 frame_epoch) {
+        this->m_camera.calculate_ray_directions();
+        this->m_camera.resize_primary_hits(primary_hit_patterns());
+        const CameraHistory& history = m_camera.history;
+        u32 history_patterns = (u32)(history.primary_hits.size() / ((size_t)history.width * history.height));
+        if (history_patterns == 0) {
+            return true;
+        }
+        m_thread_pool.push_loop(m_camera.window_height, [this, &history, history_patterns, frame_epoch](const u32 a, const u32 b) {
+            for (u32 y = a; y < b && !epoch.is_stale(frame_epoch); ++y) {
+                for (u32 x = 0; x < m_camera.window_width; ++x) {
+                    u32 index = x + y * m_camera.window_width;
+                    Sampler sampler(settings.sampler, index, 0, settings.seed);
+                    Ray ray = Ray{.origin = m_camera.position(), .direction = m_camera.get_ray(x, y)};
+                    std::optional<HitPayload> payload = primary_hit(x, y, 0, sampler, ray);
                     if (!payload.has_value()) {
-                        break;
+                        continue;
                     }
-                    light += payload->material.get_emission() * contribution;
-                    if (payload->material.get_emission() != Vec3f(0.0f)) {
-                        break;
+                    std::optional<std::pair<f32, f32>> previous = history.project(payload->hit_position);
+                    if (!previous.has_value() || previous->first < 0.0f || previous->second < 0.0f) {
+                        continue;
+                    }
+                    u32 history_x = (u32)std::lround(previous->first);
+                    u32 history_y = (u32)std::lround(previous->second);
+                    if (history_x >= history.width || history_y >= history.height) {
+                        continue;
+                    }
+                    u32 history_pixel = history_x + history_y * history.width;
+                    u32 history_index = history.accumulation_index(history_x, history_y);
+                    const PrimaryHit& history_hit = history.primary_hits[(size_t)history_pixel * history_patterns];
+                    u32 count = history.sample_counts[history_index];
+                    if (count == 0 || history_hit.object_index != payload->object_index ||
+                        history_hit.normal.dot(payload->normal) < 0.9f) {
+                        continue;
+                    }
+                    std::pair<f32, f32> jitter{0.0f, 0.0f};
+                    if (settings.antialiasing) {
+                        jitter = Sampler(settings.sampler, history_pixel, 0, settings.seed).get_2d();
                     }
+                    Vec3f history_position =
+                        history.position + history.get_ray(history_x, history_y, jitter.first, jitter.second) * history_hit.t;
+                    if ((history_position - payload->hit_position).length() >
+                        0.02f * (payload->hit_position - m_camera.position()).length()) {
+                        continue;
+                    }
+                    f32 keep = std::min((f32)settings.reprojection_max_history / (f32)count, 1.0f);
+                    u32 accumulation_index = m_camera.accumulation_index(x, y);
+                    m_camera.accumulation_data[accumulation_index] = history.accumulation_data[history_index] * keep;
+                    m_camera.accumulation_sq_data[accumulation_index] = history.accumulation_sq_data[history_index] * keep;
+                    m_camera.sample_counts[accumulation_index] = std::min(count, settings.reprojection_max_history);
                 }
             }
-            return light;
-        }
+        });
+        m_thread_pool.wait_for_tasks();
+        return !epoch.is_stale(frame_epoch);
     }
 
-    void render(u32 max_bounces) {
+    void begin_pass() {
         this->m_camera.calculate_ray_directions();
-        BS::thread_pool thread_pool(8);
-        for (i32 y = m_camera.window_height - 1; y >= 0; --y) {
-            thread_pool.push_loop(m_camera.window_width, [this, y, max_bounces](const int a, const int b) {
-                for (int x = a; x < b; ++x) {
-                    Vec3f color = per_pixel(x, y, max_bounces);
-                    m_camera.accumulation_data[x + y * m_camera.window_width] += color;
-                    auto light = m_camera.accumulation_data[x + y * m_camera.window_width] / (f32)m_camera.frame_index;
-                    m_camera.image[x + y * m_camera.window_width] =
-                        Vec4<u32>(
-                            (u32)(std::sqrt(light.x) * 255.0f), (u32)(std::sqrt(light.y) * 255.0f),
-                            (u32)(std::sqrt(light.z) * 255.0f), 255
-                        )
-                            .clamp(0, 255)
-                            .cast<u8>();
-                    ;
+        if (settings.primary_hit_cache) {
+            this->m_camera.resize_primary_hits(primary_hit_patterns());
+        }
+        bool adaptive = settings.adaptive_target_error > 0.0f;
+        m_active_tiles.clear();
+        for (u32 tile : m_camera.tile_order) {
+            if (!adaptive || !m_camera.converged_tiles[tile]) {
+                m_active_tiles.push_back(tile);
+            }
+        }
+        m_pass_cursor = 0;
+        m_pass_frame_index = m_camera.frame_index;
+        m_pass_tile_count = m_camera.tile_order.size();
+    }
+
+    void end_pass() {
+        if (settings.adaptive_target_error > 0.0f && m_camera.frame_index >= settings.adaptive_min_spp) {
+            update_converged_tiles();
+        }
+        m_camera.frame_index += 1;
+        m_pass_frame_index = m_camera.frame_index;
+    }
+
+    void render_tiles(std::span<const u32> tiles, u32 max_bounces, u64 frame_epoch) {
+        u32 workers = thread_count();
+        m_scheduler.reset(tiles, workers);
+        for (u32 worker = 0; worker < workers; ++worker) {
+            m_thread_pool.push_task([this, worker, max_bounces, frame_epoch] {
+                while (!epoch.is_stale(frame_epoch)) {
+                    std::optional<u32> tile = m_scheduler.next(worker);
+                    if (!tile.has_value()) {
+                        break;
+                    }
+                    render_tile(*tile, max_bounces);
                 }
             });
         }
-        thread_pool.wait_for_tasks();
-        m_camera.frame_index += 1;
+        m_thread_pool.wait_for_tasks();
+    }
+
+    void update_converged_tiles() {
+        m_thread_pool.push_loop(m_camera.converged_tiles.size(), [this](const u32 a, const u32 b) {
+            for (u32 tile = a; tile < b; ++tile) {
+                if (m_camera.converged_tiles[tile]) {
+                    continue;
+                }
+                TileBounds bounds = m_camera.tile_bounds(tile);
+                f32 max_error = 0.0f;
+                for (u32 y = bounds.y_begin; y < bounds.y_end; ++y) {
+                    for (u32 x = bounds.x_begin; x < bounds.x_end; ++x) {
+                        max_error = std::max(max_error, pixel_error(m_camera.accumulation_index(x, y)));
+                    }
+                }
+                m_camera.converged_tiles[tile] = max_error < settings.adaptive_target_error;
+            }
+        });
+        m_thread_pool.wait_for_tasks();
+        m_camera.converged_tiles_count = 0;
+        for (u8 tile_converged : m_camera.converged_tiles) {
+            m_camera.converged_tiles_count += tile_converged;
+        }
     }
 };
 
@@ -0,0 +1,268 @@
+#include "ray-tracing/SceneFile.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <map>
+#include <sstream>
+#include <variant>
+
+#include "ray-tracing/Environment.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "ray-tracing/objects.hpp"
+#include "utils/BS_thread_pool.hpp"
+#include "utils/MeshFile.hpp"
+#include "utils/Obj.hpp"
+#include "utils/Panic.hpp"
+
+using json = nlohmann::json;
+
+namespace RayTracer {
+
+static Vec3f read_vec3(const json& value) {
+    if (!value.is_array() || value.size() != 3) {
+        panic("expected [x, y, z], got {}", value.dump());
+    }
+    return Vec3f(value[0].get<f32>(), value[1].get<f32>(), value[2].get<f32>());
+}
+
+template <typename T>
+static void read_optional(const json& object, const char* key, T& out) {
+    if (object.contains(key)) {
+        out = object.at(key).get<T>();
+    }
+}
+
+static void read_optional(const json& object, const char* key, Vec3f& out) {
+    if (object.contains(key)) {
+        out = read_vec3(object.at(key));
+    }
+}
+
+static MaterialParams read_material(const json& object) {
+    MaterialParams params{.albedo = Vec3f(1.0f)};
+    std::string type = object.value("type", "lambertian");
+    if (type == "lambertian") {
+        params.type = MaterialType::LAMBERTIAN;
+    } else if (type == "metal") {
+        params.type = MaterialType::METAL;
+    } else if (type == "emissive") {
+        params.type = MaterialType::EMISSIVE;
+    } else {
+        panic("unknown material type {}", type);
+    }
+    read_optional(object, "albedo", params.albedo);
+    read_optional(object, "roughness", params.roughness);
+    read_optional(object, "emission_power", params.emission_power);
+    return params;
+}
+
+static void read_settings(const json& object, SceneDescription& description) {
+    RenderSettings& settings = description.settings;
+    read_optional(object, "spp", description.spp);
+    read_optional(object, "max_bounces", description.max_bounces);
+    if (object.contains("sampler")) {
+        std::string sampler = object.at("sampler").get<std::string>();
+        if (sampler == "sobol") {
+            settings.sampler = SamplerType::SOBOL;
+        } else if (sampler == "uniform") {
+            settings.sampler = SamplerType::UNIFORM;
+        } else {
+            panic("unknown sampler {}", sampler);
+        }
+    }
+    read_optional(object, "antialiasing", settings.antialiasing);
+    read_optional(object, "primary_hit_cache", settings.primary_hit_cache);
+    read_optional(object, "primary_hit_jitter_patterns", settings.primary_hit_jitter_patterns);
+    read_optional(object, "seed", settings.seed);
+    read_optional(object, "sample_offset", settings.sample_offset);
+    read_optional(object, "russian_roulette_min_depth", settings.russian_roulette_min_depth);
+    read_optional(object, "adaptive_target_error", settings.adaptive_target_error);
+    read_optional(object, "adaptive_min_spp", settings.adaptive_min_spp);
+    read_optional(object, "frame_budget_ms", settings.frame_budget_ms);
+    read_optional(object, "preview_scale", settings.preview_scale);
+    read_optional(object, "preview_settle_ms", settings.preview_settle_ms);
+    read_optional(object, "temporal_reprojection", settings.temporal_reprojection);
+    read_optional(object, "reprojection_max_history", settings.reprojection_max_history);
+    read_optional(object, "exposure", settings.exposure);
+    if (object.contains("tone_mapping")) {
+        std::string tone_mapping = object.at("tone_mapping").get<std::string>();
+        if (tone_mapping == "aces") {
+            settings.tone_mapping = ToneMapping::ACES;
+        } else if (tone_mapping == "none") {
+            settings.tone_mapping = ToneMapping::NONE;
+        } else {
+            panic("unknown tone mapping {}", tone_mapping);
+        }
+    }
+}
+
+static SceneDescription read_scene(
+    const json& root, const std::filesystem::path& base_directory, const RenderSettings& defaults
+) {
+    SceneDescription description;
+    description.settings = defaults;
+    if (root.contains("camera")) {
+        const json& camera = root.at("camera");
+        read_optional(camera, "position", description.camera.position);
+        read_optional(camera, "pitch", description.camera.pitch);
+        read_optional(camera, "yaw", description.camera.yaw);
+        read_optional(camera, "vfov", description.camera.vfov);
+        read_optional(camera, "width", description.camera.width);
+        read_optional(camera, "height", description.camera.height);
+    }
+    if (root.contains("render")) {
+        read_settings(root.at("render"), description);
+    }
+    if (root.contains("environment")) {
+        const json& environment = root.at("environment");
+        description.environment = EnvironmentDescription{
+            .path = (base_directory / environment.at("path").get<std::string>()).string(),
+            .intensity = environment.value("intensity", 1.0f),
+        };
+    }
+
+    std::map<std::string, MaterialParams> materials;
+    if (root.contains("materials")) {
+        for (const auto& [name, material] : root.at("materials").items()) {
+            materials[name] = read_material(material);
+        }
+    }
+    std::map<std::string, std::string> mesh_files;
+    if (root.contains("meshes")) {
+        for (const auto& [name, path] : root.at("meshes").items()) {
+            mesh_files[name] = (base_directory / path.get<std::string>()).string();
+        }
+    }
+    // only meshes some object uses are loaded, each of them once
+    std::map<std::string, u32> mesh_indices;
+
+    for (const json& object : root.at("objects")) {
+        ObjectDescription out;
+        std::string material = object.at("material").get<std::string>();
+        if (!materials.contains(material)) {
+            panic("unknown material {}", material);
+        }
+        out.material = materials[material];
+        read_optional(object, "position", out.position);
+
+        std::string type = object.at("type").get<std::string>();
+        if (type == "mesh") {
+            out.kind = ObjectKind::MESH;
+            std::string mesh = object.at("mesh").get<std::string>();
+            if (!mesh_files.contains(mesh)) {
+                panic("unknown mesh {}", mesh);
+            }
+            auto [it, inserted] = mesh_indices.try_emplace(mesh, (u32)description.meshes.size());
+            if (inserted) {
+                description.meshes.push_back(mesh_files[mesh]);
+            }
+            out.mesh = it->second;
+        } else if (type == "sphere") {
+            out.kind = ObjectKind::SPHERE;
+            out.radius = object.at("radius").get<f32>();
+        } else if (type == "box") {
+            out.kind = ObjectKind::BOX;
+            out.size = read_vec3(object.at("size"));
+            read_optional(object, "rotation", out.rotation);
+        } else {
+            panic("unknown object type {}", type);
+        }
+        description.objects.push_back(out);
+    }
+    return description;
+}
+
+SceneDescription parse_scene(
+    std::string_view text, const std::filesystem::path& base_directory, const RenderSettings& defaults
+) {
+    try {
+        return read_scene(json::parse(text), base_directory, defaults);
+    } catch (const json::exception& e) {
+        panic("invalid scene: {}", e.what());
+    }
+}
+
+SceneDescription parse_scene_file(
+    std::string_view file_path, SceneLoadTimings* timings, const RenderSettings& defaults
+) {
+    auto start = std::chrono::steady_clock::now();
+    std::ifstream file{std::string(file_path)};
+    if (!file.is_open()) {
+        panic("could not open scene file {}", file_path);
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    SceneDescription description = parse_scene(text.str(), std::filesystem::path(file_path).parent_path(), defaults);
+    if (timings != nullptr) {
+        timings->parse_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return description;
+}
+
+void load_scene(const SceneDescription& description, Scene& scene, SceneLoadTimings* timings) {
+    auto start = std::chrono::steady_clock::now();
+    BS::thread_pool pool;
+
+    std::optional<std::future<EnvironmentLight>> environment;
+    if (description.environment.has_value()) {
+        environment = pool.submit([&description] {
+            return EnvironmentLight(description.environment->path, description.environment->intensity);
+        });
+    }
+    // one file at a time, each split into chunks parsed on the rest of the pool. .mesh files are
+    // only mapped, their pages are read while the meshes are built
+    std::vector<std::variant<ParsedObj, MappedMesh>> sources;
+    std::vector<ObjView> parsed;
+    sources.reserve(description.meshes.size());
+    for (const std::string& path : description.meshes) {
+        if (is_mesh_file(path)) {
+            parsed.push_back(std::get<MappedMesh>(sources.emplace_back(std::in_place_type<MappedMesh>, path)).view());
+        } else {
+            parsed.push_back(std::get<ParsedObj>(sources.emplace_back(load_obj(path, pool))));
+        }
+    }
+
+    std::vector<std::optional<Mesh>> meshes(description.objects.size());
+    pool.push_loop(description.objects.size(), [&](const size_t a, const size_t b) {
+        for (size_t i = a; i < b; ++i) {
+            const ObjectDescription& object = description.objects[i];
+            if (object.kind == ObjectKind::MESH) {
+                meshes[i].emplace(object.position, Material(object.material), parsed[object.mesh]);
+            }
+        }
+    });
+    pool.wait_for_tasks();
+
+    u32 triangles = 0;
+    for (size_t i = 0; i < description.objects.size(); ++i) {
+        const ObjectDescription& object = description.objects[i];
+        switch (object.kind) {
+            case ObjectKind::MESH:
+                triangles += (u32)meshes[i]->m_triangles.size();
+                scene.add_object(std::move(*meshes[i]));
+                break;
+            case ObjectKind::SPHERE:
+                scene.add_object(Sphere(object.position, object.radius, Material(object.material)));
+                break;
+            case ObjectKind::BOX:
+                scene.add_object(Box(
+                    object.position, object.size.x, object.size.y, object.size.z, object.rotation.x,
+                    object.rotation.y, object.rotation.z, Material(object.material)
+                ));
+                break;
+        }
+    }
+    if (environment.has_value()) {
+        scene.set_environment(environment->get());
+    }
+    scene.settings = description.settings;
+    if (timings != nullptr) {
+        timings->load_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+        timings->triangles = triangles;
+    }
+}
+
+}  // namespace RayTracer
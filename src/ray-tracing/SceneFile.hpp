@@ -0,0 +1,102 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "linear_algebra/Vec3.hpp"
+#include "ray-tracing/Material.hpp"
+#include "ray-tracing/RenderSettings.hpp"
+#include "utils/types.hpp"
+
+namespace RayTracer {
+
+class Scene;
+
+struct CameraDescription {
+    f32 vfov = 45.0f;
+    Vec3f position;
+    f32 pitch = 0.0f;
+    f32 yaw = 0.0f;
+    u32 width = 1280;
+    u32 height = 1280;
+};
+
+enum class ObjectKind {
+    MESH,
+    SPHERE,
+    BOX,
+};
+
+struct ObjectDescription {
+    ObjectKind kind = ObjectKind::MESH;
+    MaterialParams material;
+    Vec3f position;
+    // MESH: index into SceneDescription::meshes, instances of the same file share it
+    u32 mesh = 0;
+    // SPHERE
+    f32 radius = 0.0f;
+    // BOX: width, height, depth and pitch, roll, yaw
+    Vec3f size;
+    Vec3f rotation;
+};
+
+struct EnvironmentDescription {
+    std::string path;
+    f32 intensity = 1.0f;
+};
+
+/*
+everything a scene file describes. the file is json:
+{
+    "camera": {"position": [x, y, z], "pitch": 0, "yaw": 0, "vfov": 45, "width": 1280, "height": 1280},
+    "render": {"spp": 1024, "max_bounces": 8, any RenderSettings field by name},
+    "environment": {"path": "sky.hdr", "intensity": 1},
+    "materials": {"name": {"type": "lambertian|metal|emissive", "albedo": [r, g, b], "roughness": 0.5, "emission_power": 0}},
+    "meshes": {"name": "file.obj or file.mesh"},
+    "objects": [
+        {"type": "mesh", "mesh": "name", "material": "name", "position": [x, y, z]},
+        {"type": "sphere", "position": [x, y, z], "radius": 1, "material": "name"},
+        {"type": "box", "position": [x, y, z], "size": [w, h, d], "rotation": [pitch, roll, yaw], "material": "name"}
+    ]
+}
+every field but the object list has a default. a mesh used by several objects is loaded once and
+instanced at each position. file paths are relative to the scene file
+*/
+struct SceneDescription {
+    CameraDescription camera;
+    RenderSettings settings;
+    u32 spp = 1024;
+    u32 max_bounces = 8;
+    std::optional<EnvironmentDescription> environment;
+    std::vector<std::string> meshes;
+    std::vector<ObjectDescription> objects;
+};
+
+struct SceneLoadTimings {
+    f64 parse_ms = 0;
+    f64 load_ms = 0;
+    u32 triangles = 0;
+};
+
+/*
+panics with the offending key when the file is malformed. the render block is read on top of
+defaults, so a program can pick its own settings and still let the file override them
+*/
+SceneDescription parse_scene(
+    std::string_view json, const std::filesystem::path& base_directory, const RenderSettings& defaults = {}
+);
+SceneDescription parse_scene_file(
+    std::string_view file_path, SceneLoadTimings* timings = nullptr, const RenderSettings& defaults = {}
+);
+
+/*
+loads the environment map while the mesh files are parsed in parallel chunks, then builds the
+meshes in parallel.
+objects are added in file order and the render settings replace the scene's
+*/
+void load_scene(const SceneDescription& description, Scene& scene, SceneLoadTimings* timings = nullptr);
+
+}  // namespace RayTracer
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "linear_algebra/Vec3.hpp"
+#include "linear_algebra/Vec4.hpp"
+#include "utils/types.hpp"
+
+namespace RayTracer {
+
+enum class ToneMapping {
+    // exposure and clamp only
+    NONE,
+    // Narkowicz's fit of the ACES filmic curve
+    ACES,
+};
+
+// https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
+inline f32 aces_filmic(f32 x) {
+    return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+}
+
+/*
+sRGB transfer function as a cubic in the fourth root, within 0.0005 of the exact curve on
+[0, 1]. square roots vectorize where the pow of the exact curve does not
+*/
+inline f32 srgb_encode(f32 linear) {
+    f32 s = std::sqrt(std::sqrt(linear));
+    f32 curve = -0.0737702917f + s * (0.2673091550f + s * (0.9331058558f + s * -0.1267577217f));
+    return linear <= 0.0031308f ? 12.92f * linear : curve;
+}
+
+inline f32 tonemap_channel(f32 linear, ToneMapping mapping) {
+    if (mapping == ToneMapping::ACES) {
+        linear = aces_filmic(linear);
+    }
+    return srgb_encode(std::clamp(linear, 0.0f, 1.0f)) * 255.0f + 0.5f;
+}
+
+inline Vec4<u8> tonemap_pixel(const Vec3f& light, f32 exposure, ToneMapping mapping) {
+    return Vec4<u8>(
+        (u8)tonemap_channel(light.x * exposure, mapping), (u8)tonemap_channel(light.y * exposure, mapping),
+        (u8)tonemap_channel(light.z * exposure, mapping), 255
+    );
+}
+
+constexpr u32 TONEMAP_BLOCK_SIZE = 256;
+
+/*
+resolves up to TONEMAP_BLOCK_SIZE accumulated pixels into 8 bit sRGB. one channel at a time
+goes through flat arrays so every loop is plain arithmetic the compiler turns into simd
+*/
+inline void tonemap_block(
+    const Vec3f* accumulation, const u32* sample_counts, u32 size, f32 exposure, ToneMapping mapping, Vec4<u8>* out
+) {
+    alignas(64) std::array<f32, TONEMAP_BLOCK_SIZE> scale;
+    alignas(64) std::array<f32, TONEMAP_BLOCK_SIZE> channel;
+    alignas(64) std::array<std::array<u32, TONEMAP_BLOCK_SIZE>, 3> bytes;
+    for (u32 i = 0; i < size; ++i) {
+        scale[i] = exposure / (f32)(i32)std::max(sample_counts[i], 1u);
+    }
+    static_assert(sizeof(Vec3f) == 3 * sizeof(f32));
+    const f32* components = &accumulation->x;
+    for (u32 c = 0; c < 3; ++c) {
+        for (u32 i = 0; i < size; ++i) {
+            channel[i] = components[3 * i + c] * scale[i];
+        }
+        if (mapping == ToneMapping::ACES) {
+            for (u32 i = 0; i < size; ++i) {
+                channel[i] = aces_filmic(channel[i]);
+            }
+        }
+        for (u32 i = 0; i < size; ++i) {
+            bytes[c][i] = (u32)(i32)(srgb_encode(std::clamp(channel[i], 0.0f, 1.0f)) * 255.0f + 0.5f);
+        }
+    }
+    // little endian rgba words, packed with integer simd instead of byte stores
+    alignas(64) std::array<u32, TONEMAP_BLOCK_SIZE> packed;
+    for (u32 i = 0; i < size; ++i) {
+        packed[i] = bytes[0][i] | bytes[1][i] << 8 | bytes[2][i] << 16 | 0xff000000u;
+    }
+    static_assert(sizeof(Vec4<u8>) == sizeof(u32));
+    std::memcpy(static_cast<void*>(out), packed.data(), size * sizeof(u32));
+}
+
+}  // namespace RayTracer
@@ -162,9 +162,8 @@ std::optional<HitPayload> Triangle::hit(const Ray& ray, f32 t_min, f32 t_max) co
 
 // https://www.realtimerendering.com/raytracinggems/unofficial_RayTracingGems_v1.9.pdf
 // 16.5.2
-std::pair<Vec3f, f32> Triangle::sample(u32& seed) const {
-    f32 u0 = rand_float(seed);
-    f32 u1 = rand_float(seed);
+std::pair<Vec3f, f32> Triangle::sample(Sampler& sampler) const {
+    auto [u0, u1] = sampler.get_2d();
     f32 beta = 1 - std::sqrt(u0);
     f32 gamma = (1 - beta) * u1;
     f32 alpha = 1 - beta - gamma;
@@ -211,10 +210,10 @@ std::optional<u32> Mesh::get_intersecting_triangle(const Ray& ray, f32 t_min, f3
     return closest_triangle;
 }
 
-std::pair<Vec3f, f32> Mesh::sample(u32& seed) const {
-    f32 random = rand_float(seed);
+std::pair<Vec3f, f32> Mesh::sample(Sampler& sampler) const {
+    f32 random = sampler.get_1d();
     u32 random_selected_index = (u32)std::floor(random * this->m_triangles.size());
-    return this->m_triangles[random_selected_index].sample(seed);
+    return this->m_triangles[random_selected_index].sample(sampler);
 }
 
 f32 Mesh::pdf(const Vec3f& sampled_light_dir, const Vec3f& hit_position, const Vec3f& hit_normal) const {
@@ -9,6 +9,7 @@
 #include "Material.hpp"
 #include "linear_algebra/Vec3.hpp"
 #include "ray-tracing/Ray.hpp"
+#include "ray-tracing/Sampler.hpp"
 #include "utils/Obj.hpp"
 #include "utils/Overloaded.hpp"
 #include "utils/SameAsAny.hpp"
@@ -21,6 +22,8 @@ struct HitPayload {
     f32 t = 0;
     bool front_face = false;
     Material material;
+    // index of the hit object in the HittableList
+    u32 object_index = 0;
 };
 
 template <typename T>
@@ -49,13 +52,23 @@ public:
         return std::get<T>(m_hittable_objects[index]);
     }
 
+    Material material(u32 index) const {
+        return std::visit(
+            overloaded{[](const auto& object) {
+                return object.material();
+            }},
+            m_hittable_objects[index]
+        );
+    }
+
     std::optional<HitPayload> closest_hit(const Ray& ray, f32 t_min, f32 t_max) const {
         std::optional<HitPayload> closest_payload = std::nullopt;
-        for (const auto& object : m_hittable_objects) {
+        for (u32 index = 0; index < m_hittable_objects.size(); ++index) {
             std::visit(
                 overloaded{[&](const auto& object) {
                     std::optional<HitPayload> payload = object.hit(ray, t_min, t_max);
                     if (payload.has_value()) {
+                        payload->object_index = index;
                         if (closest_payload.has_value()) {
                             if (closest_payload->t >= payload->t) {
                                 closest_payload = payload;
@@ -65,7 +78,7 @@ public:
                         }
                     }
                 }},
-                object
+                m_hittable_objects[index]
             );
         }
 
@@ -131,7 +144,7 @@ struct Triangle {
     }
 
     // position in object and pdf
-    std::pair<Vec3f, f32> sample(u32& seed) const;
+    std::pair<Vec3f, f32> sample(Sampler& sampler) const;
     f32 pdf(const Vec3f& sampled_light_dir, const Vec3f& hit_position, const Vec3f& hit_normal) const;
 
     Triangle(const Vec3f& position, const Material& material, const Vec3<Vec3f>& vertices)
@@ -174,20 +187,21 @@ struct Mesh {
 
     // position in object and pdf
     // pdf can NOT be 0 in this case
-    std::pair<Vec3f, f32> sample(u32& seed) const;
+    std::pair<Vec3f, f32> sample(Sampler& sampler) const;
 
     // pdf CAN be 0
     f32 pdf(const Vec3f& sampled_light_dir, const Vec3f& hit_position, const Vec3f& hit_normal) const;
     std::optional<u32> get_intersecting_triangle(const Ray& ray, f32 t_min, f32 t_max) const;
 
-    Mesh(const Vec3f& position, const Material& material, const ParsedObj& obj)
+    // position translates every vertex, so one parsed .obj can be instanced at several places
+    Mesh(const Vec3f& position, const Material& material, ObjView obj)
         : m_position(position), m_material(material) {
         m_triangles.reserve(obj.faces.size());
         for (const Vec3<Vec3<i32>>& face_indices : obj.faces) {
             // -1 because .obj starts index at 1
-            Vec3f v0 = obj.vertices[face_indices.x.x - 1];
-            Vec3f v1 = obj.vertices[face_indices.y.x - 1];
-            Vec3f v2 = obj.vertices[face_indices.z.x - 1];
+            Vec3f v0 = obj.vertices[face_indices.x.x - 1] + position;
+            Vec3f v1 = obj.vertices[face_indices.y.x - 1] + position;
+            Vec3f v2 = obj.vertices[face_indices.z.x - 1] + position;
 
             Coordinate u0 = obj.uv_map[face_indices.x.y - 1];
             Coordinate u1 = obj.uv_map[face_indices.y.y - 1];
@@ -0,0 +1,1214 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
+#include "linear_algebra/Vec3.hpp"
+#include "ray-tracing/Camera.hpp"
+#include "ray-tracing/Checkpoint.hpp"
+#include "ray-tracing/CornellBox.hpp"
+#include "ray-tracing/Environment.hpp"
+#include "ray-tracing/Material.hpp"
+#include "ray-tracing/RenderFarm.hpp"
+#include "ray-tracing/RenderThread.hpp"
+#include "ray-tracing/Sampler.hpp"
+#include "ray-tracing/Scene.hpp"
+#include "ray-tracing/SceneFile.hpp"
+#include "ray-tracing/Tonemap.hpp"
+#include "utils/AliasTable.hpp"
+#include "utils/Image.hpp"
+#include "utils/ImageWriter.hpp"
+#include "utils/MeshFile.hpp"
+#include "utils/Obj.hpp"
+#include "utils/TileScheduler.hpp"
+#include "utils/TripleBuffer.hpp"
+
+using namespace RayTracer;
+
+// incoming light with a diagonal edge so it is not aligned to the sample space axes
+static f32 sky_radiance(const Vec3f& light_vector) {
+    return (light_vector.x + 0.5f * light_vector.y > 0.25f ? 1.0f : 0.0f) + light_vector.z * light_vector.z;
+}
+
+// lambertian pixel shading, brdf * NdotL / pdf cancels to the albedo
+static f64 shade_pixel(SamplerType type, u32 pixel_index, u32 spp) {
+    Material mat({.albedo = Vec3f(1.0f)});
+    Vec3f normal(0.0f, 0.0f, 1.0f);
+    f64 sum = 0;
+    for (u32 sample = 0; sample < spp; ++sample) {
+        Sampler sampler(type, pixel_index, sample);
+        auto [light_vector, half_vector, pdf] = mat.sample(sampler, normal, normal);
+        sum += sky_radiance(light_vector);
+    }
+    return sum / spp;
+}
+
+static f64 image_rmse(SamplerType type, u32 spp, f64 reference) {
+    constexpr u32 pixels = 256;
+    f64 error = 0;
+    for (u32 pixel = 0; pixel < pixels; ++pixel) {
+        f64 diff = shade_pixel(type, pixel, spp) - reference;
+        error += diff * diff;
+    }
+    return std::sqrt(error / pixels);
+}
+
+TEST_CASE("SAMPLER: samples are in [0, 1) and deterministic") {
+    for (SamplerType type : {SamplerType::UNIFORM, SamplerType::SOBOL}) {
+        for (u32 sample = 0; sample < 1024; ++sample) {
+            Sampler a(type, 42, sample);
+            Sampler b(type, 42, sample);
+            for (u32 dimension = 0; dimension < 8; ++dimension) {
+                f32 value = a.get_1d();
+                REQUIRE(value >= 0.0f);
+                REQUIRE(value < 1.0f);
+                REQUIRE(value == b.get_1d());
+            }
+        }
+    }
+}
+
+TEST_CASE("SAMPLER: sobol is stratified") {
+    // every power of two prefix of a (0,2)-sequence puts one point in each 1/n interval
+    constexpr u32 n = 64;
+    std::array<u32, n> x_strata{};
+    std::array<u32, n> y_strata{};
+    for (u32 sample = 0; sample < n; ++sample) {
+        Sampler sampler(SamplerType::SOBOL, 3, sample);
+        auto [x, y] = sampler.get_2d();
+        x_strata[(u32)(x * n)] += 1;
+        y_strata[(u32)(y * n)] += 1;
+    }
+    for (u32 i = 0; i < n; ++i) {
+        REQUIRE(x_strata[i] == 1);
+        REQUIRE(y_strata[i] == 1);
+    }
+}
+
+TEST_CASE("SAMPLER: sobol matches uniform quality at a quarter of the spp") {
+    f64 reference = shade_pixel(SamplerType::SOBOL, 0, 1 << 20);
+    f64 sobol_error = image_rmse(SamplerType::SOBOL, 64, reference);
+    f64 uniform_error = image_rmse(SamplerType::UNIFORM, 256, reference);
+    INFO("sobol 64spp rmse " << sobol_error << ", uniform 256spp rmse " << uniform_error);
+    REQUIRE(sobol_error < uniform_error);
+}
+
+TEST_CASE("ADAPTIVE: converged tiles stop receiving samples") {
+    Camera cam(45, Vec3f(0.0f), 0, 0, 40, 24);
+    Scene scene(cam);
+    scene.settings.adaptive_min_spp = 4;
+    // nothing to hit, every pixel is black with zero variance
+    for (u32 pass = 0; pass < 6; ++pass) {
+        scene.render(8);
+    }
+    REQUIRE(scene.converged());
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width; ++x) {
+            REQUIRE(cam.sample_counts[cam.accumulation_index(x, y)] == 4);
+        }
+    }
+
+    cam.reset_accu_data();
+    REQUIRE(!scene.converged());
+}
+
+static f64 mean_luminance(const Camera& cam) {
+    f64 sum = 0;
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width; ++x) {
+            u32 index = cam.accumulation_index(x, y);
+            sum += luminance(cam.accumulation_data[index]) / (f32)cam.sample_counts[index];
+        }
+    }
+    return sum / ((f64)cam.window_width * cam.window_height);
+}
+
+// the small cornell box that renders split by passes, samples or tiles are compared against
+constexpr u32 REFERENCE_WIDTH = 40;
+constexpr u32 REFERENCE_HEIGHT = 24;
+
+static void load_cornell_reference(Scene& scene, const RenderSettings& settings, u32 passes = 0) {
+    load_cornell_box(scene);
+    scene.settings = settings;
+    for (u32 pass = 0; pass < passes; ++pass) {
+        scene.render(4);
+    }
+}
+
+TEST_CASE("RUSSIAN ROULETTE: stays unbiased") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 64, 64);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    scene.settings.russian_roulette_min_depth = 32;
+    for (u32 pass = 0; pass < 64; ++pass) {
+        scene.render(32);
+    }
+    f64 reference = mean_luminance(cam);
+
+    cam.reset_accu_data();
+    scene.settings.russian_roulette_min_depth = 1;
+    for (u32 pass = 0; pass < 64; ++pass) {
+        scene.render(32);
+    }
+    f64 roulette = mean_luminance(cam);
+    INFO("without russian roulette " << reference << ", with " << roulette);
+    REQUIRE(std::abs(roulette - reference) < 0.03 * reference);
+}
+
+TEST_CASE("RUSSIAN ROULETTE: frame time on the cornell box", "[.][benchmark]") {
+    constexpr u32 size = 128;
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, size, size);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    for (auto [max_bounces, min_depth] : {std::pair(8u, 8u), std::pair(32u, 32u), std::pair(8u, 3u), std::pair(32u, 3u)}) {
+        scene.settings.russian_roulette_min_depth = min_depth;
+        cam.reset_accu_data();
+        BENCHMARK(fmt::format("max_bounces {} russian roulette after {}", max_bounces, min_depth)) {
+            scene.render(max_bounces);
+        };
+    }
+}
+
+TEST_CASE("PRIMARY HIT CACHE: matches tracing every camera ray") {
+    Camera cached_cam(45, CORNELL_CAMERA_POSITION, 0, 0, 48, 48);
+    Camera traced_cam(45, CORNELL_CAMERA_POSITION, 0, 0, 48, 48);
+    Scene cached(cached_cam);
+    Scene traced(traced_cam);
+    load_cornell_box(cached);
+    load_cornell_box(traced);
+    cached.settings.adaptive_target_error = 0.0f;
+    traced.settings.adaptive_target_error = 0.0f;
+    traced.settings.primary_hit_cache = false;
+    for (u32 pass = 0; pass < 8; ++pass) {
+        cached.render(8);
+        traced.render(8);
+    }
+    for (u32 i = 0; i < cached_cam.accumulation_data.size(); ++i) {
+        REQUIRE(cached_cam.primary_hits[i].object_index != PrimaryHit::EMPTY);
+        REQUIRE((cached_cam.accumulation_data[i] - traced_cam.accumulation_data[i]).length() < 1e-4f);
+    }
+
+    cached_cam.reset_accu_data();
+    REQUIRE(cached_cam.primary_hits[0].object_index == PrimaryHit::EMPTY);
+}
+
+TEST_CASE("PRIMARY HIT CACHE: jitter patterns hit the cache") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 16, 16);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.antialiasing = true;
+    cam.resize_primary_hits(scene.primary_hit_patterns());
+
+    u32 patterns = scene.primary_hit_patterns();
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width; ++x) {
+            for (u32 sample = 0; sample < 3 * patterns; ++sample) {
+                Sampler sampler(scene.settings.sampler, x + y * cam.window_width, sample);
+                Ray ray = Ray{.origin = cam.position(), .direction = cam.get_ray(x, y)};
+                std::optional<HitPayload> payload = scene.primary_hit(x, y, sample, sampler, ray);
+
+                // a traced hit for the same jittered ray
+                scene.settings.primary_hit_cache = false;
+                Sampler traced_sampler(scene.settings.sampler, x + y * cam.window_width, sample % patterns);
+                Ray traced_ray = Ray{.origin = cam.position(), .direction = cam.get_ray(x, y)};
+                std::optional<HitPayload> traced = scene.primary_hit(x, y, sample % patterns, traced_sampler, traced_ray);
+                scene.settings.primary_hit_cache = true;
+
+                REQUIRE(payload.has_value() == traced.has_value());
+                if (payload.has_value()) {
+                    REQUIRE(payload->object_index == traced->object_index);
+                    REQUIRE((payload->hit_position - traced->hit_position).length() < 1e-4f);
+                    REQUIRE((payload->normal - traced->normal).length() < 1e-4f);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ENVIRONMENT: alias table follows its weights") {
+    std::vector<f32> weights = {1.0f, 0.0f, 3.0f, 4.0f};
+    AliasTable table(weights);
+    std::array<u32, 4> counts{};
+    constexpr u32 samples = 1 << 16;
+    for (u32 i = 0; i < samples; ++i) {
+        counts[table.sample(((f32)i + 0.5f) / samples)] += 1;
+    }
+    for (u32 i = 0; i < weights.size(); ++i) {
+        REQUIRE(std::abs(table.pmf(i) - weights[i] / 8.0f) < 1e-6f);
+        REQUIRE(std::abs((f32)counts[i] / samples - table.pmf(i)) < 1e-3f);
+    }
+}
+
+TEST_CASE("ENVIRONMENT: sampling pdf integrates to one and matches pdf()") {
+    // a dim sky with a bright sun in one pixel
+    constexpr u32 width = 64;
+    constexpr u32 height = 32;
+    std::vector<Vec3f> pixels(width * height, Vec3f(0.1f, 0.2f, 0.4f));
+    pixels[40 + 10 * width] = Vec3f(500.0f);
+    EnvironmentLight environment(width, height, pixels);
+
+    // integrate pdf() over the sphere with uniform directions
+    f64 integral = 0;
+    constexpr u32 samples = 1 << 16;
+    for (u32 i = 0; i < samples; ++i) {
+        Sampler sampler(SamplerType::SOBOL, 0, i);
+        auto [u, v] = sampler.get_2d();
+        f32 z = 1.0f - 2.0f * u;
+        f32 r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        Vec3f direction(r * std::cos(2.0f * PI * v), z, r * std::sin(2.0f * PI * v));
+        integral += environment.pdf(direction) * 4.0 * std::numbers::pi / samples;
+    }
+    REQUIRE(std::abs(integral - 1.0) < 0.02);
+
+    for (u32 i = 0; i < 1024; ++i) {
+        Sampler sampler(SamplerType::SOBOL, 1, i);
+        auto [direction, radiance, pdf] = environment.sample(sampler);
+        REQUIRE(std::abs(direction.length() - 1.0f) < 1e-4f);
+        REQUIRE(std::abs(pdf - environment.pdf(direction)) < 1e-2f * pdf);
+        REQUIRE((radiance - environment.eval(direction)).length() < 1e-4f);
+    }
+}
+
+TEST_CASE("ENVIRONMENT: white furnace") {
+    // a white lambertian sphere under a uniform sky reflects exactly the sky radiance
+    constexpr u32 width = 16;
+    constexpr u32 height = 8;
+    Camera cam(45, Vec3f(0.0f, 0.0f, 3.0f), 0, 0, 16, 16);
+    Scene scene(cam);
+    scene.add_object(Sphere(Vec3f(0.0f), 0.5f, Material({.albedo = Vec3f(1.0f)})));
+    scene.set_environment(EnvironmentLight(width, height, std::vector<Vec3f>(width * height, Vec3f(1.0f))));
+    scene.settings.adaptive_target_error = 0.0f;
+    for (u32 pass = 0; pass < 256; ++pass) {
+        scene.render(8);
+    }
+    REQUIRE(cam.primary_hits[8 + 8 * 16].object_index == 0);
+    REQUIRE(std::abs(mean_luminance(cam) - 1.0) < 0.01);
+}
+
+TEST_CASE("ENVIRONMENT: white furnace with a rough metal") {
+    // microfacets lose energy so the reference is the same sphere inside an emitter of the sky's
+    // radiance, which only bsdf sampling finds. the mis weights must not change the answer
+    constexpr u32 width = 16;
+    constexpr u32 height = 8;
+    for (f32 roughness : {0.2f, 0.6f}) {
+        Material metal({.type = MaterialType::METAL, .albedo = Vec3f(1.0f), .roughness = roughness});
+
+        Camera sky_cam(45, Vec3f(0.0f, 0.0f, 3.0f), 0, 0, 16, 16);
+        Scene sky(sky_cam);
+        sky.add_object(Sphere(Vec3f(0.0f), 0.5f, metal));
+        sky.set_environment(EnvironmentLight(width, height, std::vector<Vec3f>(width * height, Vec3f(1.0f))));
+        sky.settings.adaptive_target_error = 0.0f;
+
+        Camera emitter_cam(45, Vec3f(0.0f, 0.0f, 3.0f), 0, 0, 16, 16);
+        Scene emitter(emitter_cam);
+        emitter.add_object(Sphere(Vec3f(0.0f), 0.5f, metal));
+        // faces wound to be seen from inside. not a cube, so no face diagonal lines up with the pixel centers
+        ParsedObj box = parse_obj(
+            "v -20 -15 -20\nv 20 -15 -20\nv 20 15 -20\nv -20 15 -20\n"
+            "v -20 -15 20\nv 20 -15 20\nv 20 15 20\nv -20 15 20\n"
+            "vt 0 0\n"
+            "vn 0 0 1\nvn 0 0 -1\nvn 0 1 0\nvn 0 -1 0\nvn 1 0 0\nvn -1 0 0\n"
+            "f 2/1/1 3/1/1 4/1/1\nf 2/1/1 4/1/1 1/1/1\n"
+            "f 8/1/2 7/1/2 6/1/2\nf 8/1/2 6/1/2 5/1/2\n"
+            "f 5/1/3 6/1/3 2/1/3\nf 5/1/3 2/1/3 1/1/3\n"
+            "f 3/1/4 7/1/4 8/1/4\nf 3/1/4 8/1/4 4/1/4\n"
+            "f 4/1/5 8/1/5 5/1/5\nf 4/1/5 5/1/5 1/1/5\n"
+            "f 6/1/6 7/1/6 3/1/6\nf 6/1/6 3/1/6 2/1/6\n"
+        );
+        emitter.add_object(
+            Mesh(Vec3f(), Material({.type = MaterialType::EMISSIVE, .albedo = Vec3f(1.0f), .emission_power = 1.0f}), box)
+        );
+        emitter.settings.adaptive_target_error = 0.0f;
+
+        for (u32 pass = 0; pass < 512; ++pass) {
+            sky.render(8);
+            emitter.render(8);
+        }
+        INFO("roughness " << roughness << ", sky " << mean_luminance(sky_cam) << ", emitter " << mean_luminance(emitter_cam));
+        REQUIRE(std::abs(mean_luminance(sky_cam) - mean_luminance(emitter_cam)) < 0.01);
+    }
+}
+
+TEST_CASE("THREAD POOL: per frame overhead at small resolutions", "[.][benchmark]") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 16, 16);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    BENCHMARK("16x16 frame on the persistent pool") {
+        scene.render(8);
+    };
+
+    // what every frame paid before the pool was kept alive
+    BENCHMARK("spawning and joining a pool") {
+        BS::thread_pool pool(scene.thread_count());
+        return pool.get_thread_count();
+    };
+}
+
+TEST_CASE("TILE SCHEDULER: every tile is handed out exactly once") {
+    constexpr u32 workers = 4;
+    std::vector<u32> tiles(1000);
+    std::iota(tiles.begin(), tiles.end(), 0);
+    TileScheduler scheduler;
+    scheduler.reset(tiles, workers);
+
+    std::array<std::vector<u32>, workers> taken;
+    std::vector<std::thread> threads;
+    for (u32 worker = 0; worker < workers; ++worker) {
+        threads.emplace_back([&, worker] {
+            // uneven work so the fast workers have to steal
+            while (std::optional<u32> tile = scheduler.next(worker)) {
+                taken[worker].push_back(*tile);
+                if (worker == 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<u32> all;
+    for (const std::vector<u32>& worker_tiles : taken) {
+        all.insert(all.end(), worker_tiles.begin(), worker_tiles.end());
+    }
+    std::sort(all.begin(), all.end());
+    REQUIRE(all == tiles);
+}
+
+TEST_CASE("TILE SCHEDULER: scaling from 1 to N threads on the cornell box", "[.][benchmark]") {
+    constexpr u32 size = 256;
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, size, size);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    // powers of two up to every hardware thread
+    u32 max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<u32> thread_counts;
+    for (u32 threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (u32 threads : thread_counts) {
+        scene.set_thread_count(threads);
+        cam.reset_accu_data();
+        BENCHMARK(fmt::format("{} threads", threads)) {
+            scene.render(8);
+        };
+    }
+}
+
+TEST_CASE("RENDER THREAD: publishes frames and runs commands between passes") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 32, 32);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    RenderThread tracer(scene, 8, 1 << 20);
+    tracer.start();
+    while (!tracer.update_frame()) {
+        std::this_thread::yield();
+    }
+    const Frame& frame = tracer.frame();
+    REQUIRE(frame.width == 32);
+    REQUIRE(frame.height == 32);
+    REQUIRE(frame.pixels.size() == 32 * 32);
+
+    std::thread::id command_thread;
+    tracer.commands.push([&command_thread, &cam] {
+        command_thread = std::this_thread::get_id();
+        cam.update_z_position(0.1f);
+    });
+    tracer.sync();
+    REQUIRE(command_thread != std::this_thread::get_id());
+    tracer.stop();
+    REQUIRE(cam.frame_index >= 1);
+}
+
+TEST_CASE("TRIPLE BUFFER: consumer never sees a torn or older frame") {
+    TripleBuffer<std::vector<u32>> buffer;
+    constexpr u32 frames = 20000;
+    std::thread producer([&buffer] {
+        for (u32 frame = 1; frame <= frames; ++frame) {
+            buffer.back().assign(256, frame);
+            buffer.publish();
+        }
+    });
+
+    u32 last_frame = 0;
+    bool torn = false;
+    bool out_of_order = false;
+    while (last_frame < frames) {
+        if (!buffer.update()) {
+            continue;
+        }
+        const std::vector<u32>& front = buffer.front();
+        for (u32 value : front) {
+            torn |= value != front[0];
+        }
+        out_of_order |= front[0] <= last_frame;
+        last_frame = front[0];
+    }
+    producer.join();
+    REQUIRE(!torn);
+    REQUIRE(!out_of_order);
+}
+
+TEST_CASE("CANCELLATION: stale frames are abandoned between tiles") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 64, 64);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    u64 stale_epoch = scene.epoch.current();
+    scene.epoch.advance();
+    REQUIRE(!scene.render(8, stale_epoch));
+    REQUIRE(cam.frame_index == 1);
+    for (u32 count : cam.sample_counts) {
+        REQUIRE(count == 0);
+    }
+
+    // cancel from another thread while a large frame is in flight
+    Camera big_cam(45, CORNELL_CAMERA_POSITION, 0, 0, 512, 512);
+    Scene big_scene(big_cam);
+    load_cornell_box(big_scene);
+    big_scene.settings.adaptive_target_error = 0.0f;
+    std::thread editor([&big_scene, &big_cam] {
+        while (std::none_of(big_cam.sample_counts.begin(), big_cam.sample_counts.end(), [](u32 count) {
+            return count != 0;
+        })) {
+            std::this_thread::yield();
+        }
+        big_scene.epoch.advance();
+    });
+    bool completed = big_scene.render(64);
+    editor.join();
+    REQUIRE(!completed);
+    REQUIRE(big_cam.frame_index == 1);
+    REQUIRE(std::any_of(big_cam.sample_counts.begin(), big_cam.sample_counts.end(), [](u32 count) {
+        return count == 0;
+    }));
+}
+
+TEST_CASE("FRAME BUDGET: passes are split across calls and capped at max_spp") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 128, 128);
+    Scene scene(cam, 2);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+
+    // a budget below one tile renders one tile per worker every call
+    scene.settings.frame_budget_ms = 0.001f;
+    u32 calls = 0;
+    while (cam.frame_index == 1) {
+        REQUIRE(scene.render(8));
+        calls += 1;
+    }
+    REQUIRE(calls == cam.tile_order.size() / scene.thread_count());
+    for (u32 count : cam.sample_counts) {
+        REQUIRE(count == 1);
+    }
+
+    // a budget of several passes stops at max_spp
+    scene.settings.frame_budget_ms = 10000.0f;
+    REQUIRE(scene.render(8, scene.epoch.current(), 6));
+    REQUIRE(cam.frame_index == 6);
+    REQUIRE(scene.pass_tiles_left() == 0);
+    for (u32 count : cam.sample_counts) {
+        REQUIRE(count == 5);
+    }
+
+    // a resize in the middle of a pass starts over on the new tiles
+    scene.settings.frame_budget_ms = 0.001f;
+    REQUIRE(scene.render(8));
+    REQUIRE(scene.pass_tiles_left() > 0);
+    cam.resize_camera(40, 40);
+    REQUIRE(scene.render(8));
+    REQUIRE(scene.pass_tiles_left() == cam.tile_order.size() - scene.thread_count());
+}
+
+TEST_CASE("PREVIEW: resolution steps up once the camera settles") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 100, 100);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+    scene.settings.preview_scale = 8;
+
+    // a moving camera stays at the coarsest level
+    scene.settings.preview_settle_ms = 1e6f;
+    for (u32 frame = 0; frame < 3; ++frame) {
+        REQUIRE(scene.render(8));
+        REQUIRE(scene.preview_scale() == 8);
+        cam.update_x_position(0.01f);
+    }
+
+    scene.settings.preview_settle_ms = 0.0f;
+    for (u32 scale : {8u, 4u, 2u}) {
+        REQUIRE(scene.preview_scale() == scale);
+        REQUIRE(scene.render(8));
+        // every block is a single color, edge blocks included
+        for (u32 y = 0; y < cam.window_height; ++y) {
+            for (u32 x = 0; x < cam.window_width; ++x) {
+                Vec4<u8> pixel = cam.image[x + y * cam.window_width];
+                Vec4<u8> block = cam.image[(x / scale * scale) + (y / scale * scale) * cam.window_width];
+                REQUIRE((pixel.x == block.x && pixel.y == block.y && pixel.z == block.z));
+            }
+        }
+        REQUIRE(cam.frame_index == 1);
+        REQUIRE(std::all_of(cam.sample_counts.begin(), cam.sample_counts.end(), [](u32 count) {
+            return count == 0;
+        }));
+    }
+
+    REQUIRE(scene.preview_scale() == 1);
+    REQUIRE(scene.render(8));
+    REQUIRE(cam.frame_index == 2);
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width; ++x) {
+            REQUIRE(cam.sample_counts[cam.accumulation_index(x, y)] == 1);
+        }
+    }
+}
+
+TEST_CASE("REPROJECTION: small camera moves keep the history of visible pixels") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 64, 64);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+    scene.settings.temporal_reprojection = true;
+    scene.settings.reprojection_max_history = 16;
+    for (u32 pass = 0; pass < 32; ++pass) {
+        scene.render(8);
+    }
+
+    cam.update_x_position(0.05f);
+    cam.rotate(0.002f, 0.004f);
+    scene.render(8);
+    REQUIRE(cam.frame_index == 2);
+    u32 kept = 0;
+    for (u32 count : cam.sample_counts) {
+        REQUIRE(count >= 1);
+        REQUIRE(count <= 17);
+        kept += count > 1;
+    }
+    INFO("kept " << kept << " of " << cam.sample_counts.size());
+    REQUIRE(kept > cam.sample_counts.size() * 8 / 10);
+    f64 reprojected = mean_luminance(cam);
+
+    Camera fresh_cam(45, CORNELL_CAMERA_POSITION, 0, 0, 64, 64);
+    Scene fresh(fresh_cam);
+    load_cornell_box(fresh);
+    fresh.settings.adaptive_target_error = 0.0f;
+    fresh_cam.update_x_position(0.05f);
+    fresh_cam.rotate(0.002f, 0.004f);
+    for (u32 pass = 0; pass < 32; ++pass) {
+        fresh.render(8);
+    }
+    f64 reference = mean_luminance(fresh_cam);
+    INFO("reprojected " << reprojected << ", rendered " << reference);
+    REQUIRE(std::abs(reprojected - reference) < 0.05 * reference);
+
+    // scene edits still start over
+    cam.reset_accu_data();
+    scene.render(8);
+    for (u32 count : cam.sample_counts) {
+        REQUIRE(count == 1);
+    }
+}
+
+TEST_CASE("REPROJECTION: an abandoned reprojection does not keep the history") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 32, 32);
+    Scene scene(cam);
+    load_cornell_box(scene);
+    scene.settings.adaptive_target_error = 0.0f;
+    scene.settings.temporal_reprojection = true;
+    for (u32 pass = 0; pass < 4; ++pass) {
+        scene.render(8);
+    }
+
+    cam.update_x_position(0.05f);
+    u64 frame_epoch = scene.epoch.current();
+    scene.epoch.advance();
+    REQUIRE_FALSE(scene.render(8, frame_epoch));
+    REQUIRE_FALSE(cam.history.valid);
+
+    // the next move saves the view it leaves, not the one from before the abandoned frame
+    for (u32 pass = 0; pass < 4; ++pass) {
+        scene.render(8);
+    }
+    Vec3f moved_position = cam.position();
+    cam.update_x_position(0.05f);
+    REQUIRE(cam.history.valid);
+    REQUIRE(cam.history.position == moved_position);
+}
+
+TEST_CASE("TILED LAYOUT: every pixel has its own slot and tiles are contiguous") {
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 100, 37);
+    REQUIRE(cam.accumulation_data.size() == cam.accumulation_size());
+    std::vector<u8> used(cam.accumulation_size(), 0);
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width; ++x) {
+            u32 index = cam.accumulation_index(x, y);
+            REQUIRE(index < cam.accumulation_size());
+            REQUIRE(used[index] == 0);
+            used[index] = 1;
+            u32 tile_begin = cam.tile_index(x, y) * Camera::TILE_SIZE * Camera::TILE_SIZE;
+            REQUIRE(index >= tile_begin);
+            REQUIRE(index < tile_begin + Camera::TILE_SIZE * Camera::TILE_SIZE);
+        }
+    }
+    // the 2x2 quads of a tile are consecutive along the morton curve
+    REQUIRE(cam.accumulation_index(1, 1) == cam.accumulation_index(0, 0) + 3);
+}
+
+TEST_CASE("TONEMAP: srgb approximation and resolving the accumulation") {
+    for (u32 i = 0; i <= 10000; ++i) {
+        f32 linear = (f32)i / 10000.0f;
+        f32 exact = linear <= 0.0031308f ? 12.92f * linear : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        REQUIRE(std::abs(srgb_encode(linear) - exact) < 0.001f);
+    }
+    REQUIRE(tonemap_pixel(Vec3f(0.0f), 1.0f, ToneMapping::ACES).w == 0);
+    REQUIRE(tonemap_pixel(Vec3f(100.0f), 1.0f, ToneMapping::ACES).w == 255);
+    REQUIRE(tonemap_pixel(Vec3f(0.5f), 2.0f, ToneMapping::NONE).w == 255);
+
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, 40, 24);
+    Scene scene(cam);
+    scene.settings.tone_mapping = ToneMapping::NONE;
+    std::fill(cam.image.begin(), cam.image.end(), Vec4<u8>(1, 2, 3, 4));
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width / 2; ++x) {
+            u32 index = cam.accumulation_index(x, y);
+            cam.accumulation_data[index] = Vec3f((f32)x / (f32)cam.window_width, 0.25f, 1.0f) * 4.0f;
+            cam.sample_counts[index] = 4;
+        }
+    }
+    scene.resolve_image();
+    for (u32 y = 0; y < cam.window_height; ++y) {
+        for (u32 x = 0; x < cam.window_width; ++x) {
+            Vec4<u8> pixel = cam.image[x + y * cam.window_width];
+            if (x < cam.window_width / 2) {
+                Vec4<u8> expected = tonemap_pixel(Vec3f((f32)x / (f32)cam.window_width, 0.25f, 1.0f), 1.0f, ToneMapping::NONE);
+                REQUIRE((pixel.w == expected.w && pixel.x == expected.x && pixel.y == expected.y && pixel.z == 255));
+            } else {
+                // no samples yet, left untouched
+                REQUIRE(pixel.w == 1);
+            }
+        }
+    }
+}
+
+TEST_CASE("TONEMAP: time of the display conversion", "[.][benchmark]") {
+    constexpr u32 size = 1280;
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, size, size);
+    Scene scene(cam);
+    for (u32 i = 0; i < cam.accumulation_data.size(); ++i) {
+        cam.accumulation_data[i] = Vec3f((f32)(i % 97) / 13.0f, (f32)(i % 31) / 7.0f, (f32)(i % 11) / 3.0f);
+        cam.sample_counts[i] = 1 + i % 5;
+    }
+
+    // the conversion every sample used to pay inside render_tile
+    BENCHMARK("per pixel sqrt gamma") {
+        for (u32 y = 0; y < size; ++y) {
+            for (u32 x = 0; x < size; ++x) {
+                u32 index = cam.accumulation_index(x, y);
+                Vec3f light = cam.accumulation_data[index] / (f32)cam.sample_counts[index];
+                cam.image[x + y * size] = Vec4<u32>(
+                                              (u32)(std::sqrt(light.x) * 255.0f), (u32)(std::sqrt(light.y) * 255.0f),
+                                              (u32)(std::sqrt(light.z) * 255.0f), 255
+                )
+                                              .clamp(0, 255)
+                                              .cast<u8>();
+            }
+        }
+    };
+    BENCHMARK("resolve_image, aces + srgb") {
+        scene.resolve_image();
+    };
+    scene.settings.tone_mapping = ToneMapping::NONE;
+    BENCHMARK("resolve_image, srgb") {
+        scene.resolve_image();
+    };
+}
+
+TEST_CASE("SCENE FILE: objects, instances and settings") {
+    SceneDescription description = parse_scene(
+        R"({
+            "camera": {"position": [0, 1, 5], "vfov": 60, "width": 64, "height": 32},
+            "render": {"spp": 16, "max_bounces": 4, "sampler": "uniform", "adaptive_target_error": 0, "tone_mapping": "none"},
+            "materials": {
+                "white": {"albedo": [1, 1, 1]},
+                "mirror": {"type": "metal", "albedo": [0.9, 0.9, 0.9], "roughness": 0.1}
+            },
+            "meshes": {"floor": "floor.obj", "unused": "missing.obj"},
+            "objects": [
+                {"type": "mesh", "mesh": "floor", "material": "white"},
+                {"type": "mesh", "mesh": "floor", "material": "mirror", "position": [0, 2, 0]},
+                {"type": "sphere", "position": [0, 0, -1], "radius": 0.5, "material": "mirror"},
+                {"type": "box", "position": [1, 0, 0], "size": [1, 2, 3], "material": "white"}
+            ]
+        })",
+        "."
+    );
+    REQUIRE(description.camera.vfov == 60.0f);
+    REQUIRE(description.camera.width == 64);
+    REQUIRE(description.spp == 16);
+    REQUIRE(description.max_bounces == 4);
+    REQUIRE(description.settings.sampler == SamplerType::UNIFORM);
+    REQUIRE(description.settings.tone_mapping == ToneMapping::NONE);
+    // both instances share the one file, unused meshes are never loaded
+    REQUIRE(description.meshes.size() == 1);
+    REQUIRE(description.objects.size() == 4);
+
+    Camera cam(
+        description.camera.vfov, description.camera.position, description.camera.pitch, description.camera.yaw,
+        description.camera.width, description.camera.height
+    );
+    Scene scene(cam);
+    SceneLoadTimings timings;
+    load_scene(description, scene, &timings);
+    REQUIRE(scene.settings.adaptive_target_error == 0.0f);
+
+    const Mesh& floor = scene.get_object<Mesh>(0);
+    const Mesh& instance = scene.get_object<Mesh>(1);
+    REQUIRE(timings.triangles == 2 * floor.m_triangles.size());
+    REQUIRE(instance.m_material.type == MaterialType::METAL);
+    for (u32 i = 0; i < floor.m_triangles.size(); ++i) {
+        REQUIRE((instance.m_triangles[i].m_vertices.x - floor.m_triangles[i].m_vertices.x - Vec3f(0, 2, 0)).length() < 1e-5f);
+    }
+    REQUIRE(scene.get_object<Sphere>(2).m_radius == 0.5f);
+    REQUIRE(scene.get_object<Box>(3).m_box_max.z == 1.5f);
+    REQUIRE(scene.render(description.max_bounces));
+}
+
+TEST_CASE("SCENE FILE: the render block overrides the program's defaults") {
+    RenderSettings defaults;
+    defaults.frame_budget_ms = 16.0f;
+    defaults.preview_scale = 8;
+    SceneDescription description = parse_scene(R"({"render": {"preview_scale": 2}, "objects": []})", ".", defaults);
+    REQUIRE(description.settings.frame_budget_ms == 16.0f);
+    REQUIRE(description.settings.preview_scale == 2);
+}
+
+TEST_CASE("OBJ: single pass parser") {
+    ParsedObj obj = parse_obj(
+        "# comment\n"
+        "o Cube\n"
+        "v 1.0 -2.5  3e-1\r\n"
+        "v\t0 0 0\n"
+        "v 1 1 1\n"
+        "vn 0 0 1\n"
+        "vt 0.25 0.75\n"
+        "s 0\n"
+        "f 1/1/1 2/1/1  3/1/1"
+    );
+    REQUIRE(obj.vertices.size() == 3);
+    REQUIRE(obj.vertices[0].x == 1.0f);
+    REQUIRE(obj.vertices[0].y == -2.5f);
+    REQUIRE(obj.vertices[0].z == 0.3f);
+    REQUIRE(obj.vertex_normals.size() == 1);
+    REQUIRE(obj.uv_map.size() == 1);
+    REQUIRE(obj.uv_map[0].y == 0.75f);
+    // the last line has no newline
+    REQUIRE(obj.faces.size() == 1);
+    REQUIRE(obj.faces[0].y.x == 2);
+
+    ParsedObj suzanne = load_obj("suzanne.obj");
+    REQUIRE(suzanne.faces.size() == 967);
+    for (const auto& face : suzanne.faces) {
+        REQUIRE(face.x.x >= 1);
+        REQUIRE(face.z.x <= (i32)suzanne.vertices.size());
+    }
+}
+
+TEST_CASE("OBJ: load time of a 1M face mesh", "[.][benchmark]") {
+    // a grid of 2 triangles per quad, the same layout blender exports
+    constexpr u32 quads = 708;
+    std::string path = (std::filesystem::temp_directory_path() / "ray_tracer_grid.obj").string();
+    {
+        std::string text;
+        for (u32 y = 0; y <= quads; ++y) {
+            for (u32 x = 0; x <= quads; ++x) {
+                text += fmt::format("v {:.6f} {:.6f} {:.6f}\n", x * 0.01f, y * 0.01f, std::sin(x * 0.1f) * 0.1f);
+                text += fmt::format("vt {:.6f} {:.6f}\n", x / (f32)quads, y / (f32)quads);
+            }
+        }
+        text += "vn 0.0000 0.0000 1.0000\n";
+        for (u32 y = 0; y < quads; ++y) {
+            for (u32 x = 0; x < quads; ++x) {
+                u32 a = y * (quads + 1) + x + 1;
+                u32 b = a + 1;
+                u32 c = a + quads + 1;
+                u32 d = c + 1;
+                text += fmt::format("f {0}/{0}/1 {1}/{1}/1 {2}/{2}/1\nf {1}/{1}/1 {3}/{3}/1 {2}/{2}/1\n", a, b, c, d);
+            }
+        }
+        std::ofstream(path, std::ios::binary) << text;
+    }
+    ParsedObj obj = load_obj(path);
+    REQUIRE(obj.faces.size() == 2 * quads * quads);
+    REQUIRE(obj.vertices.size() == (quads + 1) * (quads + 1));
+    BENCHMARK("load_obj") {
+        return load_obj(path);
+    };
+
+    for (u32 threads = 1; threads <= std::thread::hardware_concurrency(); threads *= 2) {
+        BS::thread_pool pool(threads);
+        ParsedObj chunked = load_obj(path, pool);
+        REQUIRE(chunked.faces.size() == obj.faces.size());
+        REQUIRE(chunked.faces.back().z.x == obj.faces.back().z.x);
+        REQUIRE(chunked.vertices.back().z == obj.vertices.back().z);
+        BENCHMARK(fmt::format("load_obj chunked, {} threads", threads)) {
+            return load_obj(path, pool);
+        };
+    }
+
+    // building the mesh reads every page of a mapped file, so that is where its load time shows up
+    std::string mesh_path = (std::filesystem::temp_directory_path() / "ray_tracer_grid.mesh").string();
+    write_mesh_file(mesh_path, obj);
+    Mesh from_obj(Vec3f(), Material({}), load_obj(path));
+    Mesh from_mesh_file(Vec3f(), Material({}), MappedMesh(mesh_path).view());
+    BENCHMARK("load_obj + Mesh") {
+        return Mesh(Vec3f(), Material({}), load_obj(path));
+    };
+    BENCHMARK("MappedMesh + Mesh") {
+        return Mesh(Vec3f(), Material({}), MappedMesh(mesh_path).view());
+    };
+    REQUIRE(from_mesh_file.m_triangles.size() == from_obj.m_triangles.size());
+    std::filesystem::remove(path);
+    std::filesystem::remove(mesh_path);
+}
+
+TEST_CASE("MESH FILE: round trip through the binary format") {
+    ParsedObj obj = load_obj("suzanne.obj");
+    std::string path = (std::filesystem::temp_directory_path() / "ray_tracer_suzanne.mesh").string();
+    write_mesh_file(path, obj);
+    {
+        MappedMesh mapped(path);
+        ObjView view = mapped.view();
+        REQUIRE(view.vertices.size() == obj.vertices.size());
+        REQUIRE(view.uv_map.size() == obj.uv_map.size());
+        REQUIRE(view.faces.size() == obj.faces.size());
+        REQUIRE((uintptr_t)view.faces.data() % MESH_FILE_ALIGNMENT == 0);
+        REQUIRE(std::memcmp(view.vertices.data(), obj.vertices.data(), obj.vertices.size() * sizeof(Vec3f)) == 0);
+        REQUIRE(std::memcmp(view.vertex_normals.data(), obj.vertex_normals.data(), obj.vertex_normals.size() * sizeof(Vec3f)) == 0);
+        REQUIRE(std::memcmp(view.faces.data(), obj.faces.data(), obj.faces.size() * sizeof(obj.faces[0])) == 0);
+
+        Mesh parsed(Vec3f(1, 0, 0), Material({}), obj);
+        Mesh mapped_mesh(Vec3f(1, 0, 0), Material({}), view);
+        for (u32 i = 0; i < parsed.m_triangles.size(); ++i) {
+            REQUIRE(parsed.m_triangles[i].m_vertices.y == mapped_mesh.m_triangles[i].m_vertices.y);
+            REQUIRE(parsed.m_triangles[i].m_normal == mapped_mesh.m_triangles[i].m_normal);
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("OBJ: chunked parsing matches and resolves relative indices") {
+    // every face refers back to the three vertices written right before it
+    std::string text;
+    u32 triangles = 0;
+    while (text.size() < 3 * OBJ_MIN_CHUNK_SIZE) {
+        for (u32 i = 0; i < 3; ++i) {
+            text += fmt::format("v {} {} 0\nvt 0 {}\n", triangles, i, i);
+        }
+        text += fmt::format("vn 0 0 {}\nf -3/-3/-1 -2/-2/-1 -1/-1/-1\n", triangles);
+        ++triangles;
+    }
+    ParsedObj single = parse_obj(text);
+    BS::thread_pool pool(4);
+    ParsedObj chunked = parse_obj(text, pool);
+    REQUIRE(chunked.faces.size() == triangles);
+    REQUIRE(chunked.vertices.size() == single.vertices.size());
+    for (u32 i = 0; i < triangles; ++i) {
+        const auto& face = chunked.faces[i];
+        REQUIRE(face.x == Vec3<i32>(3 * i + 1, 3 * i + 1, i + 1));
+        REQUIRE(face.z == Vec3<i32>(3 * i + 3, 3 * i + 3, i + 1));
+        REQUIRE(face.y == single.faces[i].y);
+        REQUIRE(chunked.vertices[3 * i].x == (f32)i);
+    }
+}
+
+TEST_CASE("IMAGE WRITER: bmp, png and pfm read back through stb_image") {
+    // odd width so bmp rows need padding
+    constexpr u32 width = 7;
+    constexpr u32 height = 5;
+    std::vector<Vec4<u8>> pixels(width * height);
+    std::vector<Vec3f> radiance(width * height);
+    for (u32 i = 0; i < width * height; ++i) {
+        pixels[i] = Vec4<u8>((u8)(i * 7), (u8)(i * 3 + 1), (u8)(255 - i), 255);
+        radiance[i] = Vec3f((f32)i, 0.5f, -1.0f / (f32)(i + 1));
+    }
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string bmp = (directory / "ray_tracer_image.bmp").string();
+    std::string png = (directory / "ray_tracer_image.png").string();
+    std::string pfm = (directory / "ray_tracer_image.pfm").string();
+    {
+        ImageWriter writer;
+        writer.write(bmp, pixels, width, height);
+        writer.write(png, pixels, width, height);
+        writer.write_hdr(pfm, radiance, width, height);
+        writer.wait();
+    }
+
+    for (const std::string& path : {bmp, png}) {
+        Image image(path);
+        REQUIRE(image.width == (i32)width);
+        REQUIRE(image.height == (i32)height);
+        REQUIRE(image.channels == 3);
+        for (u32 i = 0; i < width * height; ++i) {
+            REQUIRE(image.img[3 * i] == pixels[i].w);
+            REQUIRE(image.img[3 * i + 1] == pixels[i].x);
+            REQUIRE(image.img[3 * i + 2] == pixels[i].y);
+        }
+    }
+
+    std::ifstream file(pfm, std::ios::binary);
+    std::string magic;
+    u32 file_width = 0;
+    u32 file_height = 0;
+    f32 scale = 0;
+    file >> magic >> file_width >> file_height >> scale;
+    file.get();
+    REQUIRE(magic == "PF");
+    REQUIRE(file_width == width);
+    REQUIRE(file_height == height);
+    REQUIRE(scale < 0.0f);
+    // bottom row first
+    std::vector<Vec3f> row(width);
+    file.read(reinterpret_cast<char*>(row.data()), width * sizeof(Vec3f));
+    for (u32 x = 0; x < width; ++x) {
+        REQUIRE(row[x] == radiance[(height - 1) * width + x]);
+    }
+    file.close();
+    for (const std::string& path : {bmp, png, pfm}) {
+        std::filesystem::remove(path);
+    }
+}
+
+TEST_CASE("CHECKPOINT: resuming matches an uninterrupted render") {
+    constexpr u32 passes = 6;
+    RenderSettings settings{.adaptive_target_error = 0.05f, .adaptive_min_spp = 2};
+
+    Camera reference_cam(45, CORNELL_CAMERA_POSITION, 0, 0, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+    Scene reference(reference_cam, 2);
+    load_cornell_reference(reference, settings, passes);
+
+    std::string path = (std::filesystem::temp_directory_path() / "ray_tracer.checkpoint").string();
+    u64 fingerprint = checkpoint_fingerprint("cornell");
+    {
+        Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+        Scene scene(cam, 2);
+        load_cornell_reference(scene, settings, passes / 2);
+        REQUIRE(write_checkpoint(path, cam, scene.settings, fingerprint));
+    }
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+    Scene scene(cam, 2);
+    load_cornell_reference(scene, settings);
+    REQUIRE_FALSE(load_checkpoint(path + ".missing", cam, scene.settings, fingerprint));
+    REQUIRE(load_checkpoint(path, cam, scene.settings, fingerprint));
+    REQUIRE(cam.frame_index == passes / 2 + 1);
+    for (u32 i = passes / 2; i < passes; ++i) {
+        scene.render(4);
+    }
+    REQUIRE(cam.frame_index == reference_cam.frame_index);
+    REQUIRE(cam.converged_tiles_count == reference_cam.converged_tiles_count);
+    REQUIRE(cam.sample_counts == reference_cam.sample_counts);
+    for (size_t i = 0; i < cam.accumulation_data.size(); ++i) {
+        REQUIRE(cam.accumulation_data[i] == reference_cam.accumulation_data[i]);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SAMPLE SPLIT: merged ranges match one render") {
+    Camera reference_cam(45, CORNELL_CAMERA_POSITION, 0, 0, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+    Scene reference(reference_cam, 2);
+    load_cornell_reference(reference, {.adaptive_target_error = 0.0f}, 8);
+
+    u64 fingerprint = checkpoint_fingerprint("cornell");
+    std::vector<std::string> paths;
+    for (u32 offset : {0u, 4u}) {
+        Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+        Scene scene(cam, 2);
+        load_cornell_reference(scene, {.sample_offset = offset, .adaptive_target_error = 0.0f}, 4);
+        paths.push_back((std::filesystem::temp_directory_path() / fmt::format("ray_tracer.part{}", offset)).string());
+        REQUIRE(write_checkpoint(paths.back(), cam, scene.settings, fingerprint));
+    }
+
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+    PartialRender first = add_checkpoint(paths[0], cam);
+    PartialRender second = add_checkpoint(paths[1], cam);
+    REQUIRE(first.max_samples == 4);
+    REQUIRE(second.header.sample_offset == 4);
+    REQUIRE(cam.sample_counts == reference_cam.sample_counts);
+    for (size_t i = 0; i < cam.accumulation_data.size(); ++i) {
+        // the sums only differ in the order the samples were added
+        Vec3f difference = cam.accumulation_data[i] - reference_cam.accumulation_data[i];
+        REQUIRE(std::abs(difference.x) + std::abs(difference.y) + std::abs(difference.z) < 1e-3f);
+    }
+    for (const std::string& path : paths) {
+        std::filesystem::remove(path);
+    }
+}
+
+TEST_CASE("RENDER FARM: stitched tiles match one render") {
+    constexpr u32 width = REFERENCE_WIDTH;
+    constexpr u32 height = REFERENCE_HEIGHT;
+    constexpr u32 spp = 4;
+    u64 fingerprint = checkpoint_fingerprint("cornell");
+
+    Camera reference_cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+    Scene reference(reference_cam, 2);
+    load_cornell_reference(reference, {.adaptive_target_error = 0.0f}, spp);
+
+    Socket listener = Socket::listen("127.0.0.1", 0);
+    REQUIRE(listener.is_open());
+    u16 port = listener.port();
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+    RenderSettings settings;
+    FarmSettings farm{.worker_count = 4, .spp = spp, .lease_timeout_seconds = 0.5, .scene_fingerprint = fingerprint};
+    FarmStats stats;
+    bool complete = false;
+    std::thread coordinator([&] {
+        complete = run_farm_coordinator(listener, cam, settings, farm, &stats);
+    });
+
+    // takes a lease and goes away, then one that takes leases and never answers
+    auto take_lease = [&](Socket& socket) {
+        FarmHello hello{
+            .width = width,
+            .height = height,
+            .seed = settings.seed,
+            .sampler = (u32)settings.sampler,
+            .threads = 1,
+            .scene_fingerprint = fingerprint,
+        };
+        FarmMessageHeader header{.type = FarmMessage::HELLO, .size = sizeof(hello)};
+        FarmLease lease;
+        REQUIRE((socket.send_value(header) && socket.send_value(hello)));
+        REQUIRE((socket.receive_value(header) && socket.receive_value(lease)));
+        REQUIRE(header.type == FarmMessage::LEASE);
+    };
+    {
+        Socket quitter = Socket::connect("127.0.0.1", port);
+        take_lease(quitter);
+    }
+    Socket hung = Socket::connect("127.0.0.1", port);
+    take_lease(hung);
+    {
+        Camera other_cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+        Scene other(other_cam, 1);
+        Socket socket = Socket::connect("127.0.0.1", port);
+        REQUIRE_FALSE(run_farm_worker(socket, other, 4, fingerprint + 1));
+    }
+
+    std::vector<std::thread> workers;
+    std::array<bool, 2> served{};
+    for (u32 i = 0; i < served.size(); ++i) {
+        workers.emplace_back([&, i] {
+            Camera worker_cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+            Scene scene(worker_cam, 2);
+            load_cornell_reference(scene, {.adaptive_target_error = 0.0f});
+            Socket socket = Socket::connect("127.0.0.1", port);
+            served[i] = run_farm_worker(socket, scene, 4, fingerprint);
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    coordinator.join();
+
+    REQUIRE(complete);
+    REQUIRE(served[0]);
+    REQUIRE(served[1]);
+    REQUIRE(stats.workers == 4);
+    REQUIRE(stats.rejected_workers == 1);
+    REQUIRE(stats.stolen_leases + stats.expired_leases > 0);
+    REQUIRE(cam.frame_index == reference_cam.frame_index);
+    REQUIRE(cam.sample_counts == reference_cam.sample_counts);
+    for (size_t i = 0; i < cam.accumulation_data.size(); ++i) {
+        REQUIRE(cam.accumulation_data[i] == reference_cam.accumulation_data[i]);
+    }
+}
+
+TEST_CASE("RENDER FARM: peers that stop halfway through a message are dropped") {
+    constexpr u32 width = REFERENCE_WIDTH;
+    constexpr u32 height = REFERENCE_HEIGHT;
+    constexpr u32 spp = 4;
+    u64 fingerprint = checkpoint_fingerprint("cornell");
+
+    Camera reference_cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+    Scene reference(reference_cam, 2);
+    load_cornell_reference(reference, {.adaptive_target_error = 0.0f}, spp);
+    // loaded up front, the coordinator gives up when no worker shows up for a lease timeout
+    Camera worker_cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+    Scene worker_scene(worker_cam, 2);
+    load_cornell_reference(worker_scene, {.adaptive_target_error = 0.0f});
+
+    Socket listener = Socket::listen("127.0.0.1", 0);
+    REQUIRE(listener.is_open());
+    u16 port = listener.port();
+    Camera cam(45, CORNELL_CAMERA_POSITION, 0, 0, width, height);
+    RenderSettings settings;
+    FarmSettings farm{.worker_count = 2, .spp = spp, .lease_timeout_seconds = 0.5, .scene_fingerprint = fingerprint};
+    FarmStats stats;
+    bool complete = false;
+    std::thread coordinator([&] {
+        complete = run_farm_coordinator(listener, cam, settings, farm, &stats);
+    });
+
+    // connects and never says anything, then one that sends the header of its hello only
+    Socket silent = Socket::connect("127.0.0.1", port);
+    Socket half_hello = Socket::connect("127.0.0.1", port);
+    FarmMessageHeader header{.type = FarmMessage::HELLO, .size = sizeof(FarmHello)};
+    REQUIRE(half_hello.send_value(header));
+
+    // takes a lease and sends half of the tile back
+    Socket stalled = Socket::connect("127.0.0.1", port);
+    FarmHello hello{
+        .width = width,
+        .height = height,
+        .seed = settings.seed,
+        .sampler = (u32)settings.sampler,
+        .threads = 1,
+        .scene_fingerprint = fingerprint,
+    };
+    FarmLease lease;
+    REQUIRE((stalled.send_value(header) && stalled.send_value(hello)));
+    REQUIRE((stalled.receive_value(header) && stalled.receive_value(lease)));
+    REQUIRE(header.type == FarmMessage::LEASE);
+    header = FarmMessageHeader{.type = FarmMessage::TILE, .size = FARM_TILE_MESSAGE_SIZE};
+    std::vector<std::byte> half_tile(FARM_TILE_MESSAGE_SIZE / 2, std::byte{0x7f});
+    REQUIRE((stalled.send_value(header) && stalled.send_value(FarmTile{.tile = lease.tile}) && stalled.send_all(half_tile)));
+
+    bool served = false;
+    std::thread worker([&] {
+        Socket socket = Socket::connect("127.0.0.1", port);
+        served = run_farm_worker(socket, worker_scene, 4, fingerprint);
+    });
+    worker.join();
+    coordinator.join();
+
+    REQUIRE(complete);
+    REQUIRE(served);
+    REQUIRE(stats.workers == 2);
+    REQUIRE(stats.rejected_workers == 2);
+    REQUIRE(cam.sample_counts == reference_cam.sample_counts);
+    for (size_t i = 0; i < cam.accumulation_data.size(); ++i) {
+        REQUIRE(cam.accumulation_data[i] == reference_cam.accumulation_data[i]);
+    }
+}
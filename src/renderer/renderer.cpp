@@ -1402,7 +1402,7 @@ void Renderer::create_texture_sampler() {
 }
 
 
-void Renderer::update_image(uint8_t *image_data) {
+void Renderer::update_image(const uint8_t *image_data) {
     m_image_data = image_data;
     m_image_updated = true;
 }
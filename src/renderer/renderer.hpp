@@ -148,7 +148,7 @@ class Renderer {
     std::vector<VkDeviceMemory> m_image_buffers_memory;
     std::vector<void*> m_image_buffers_mapped;
     
-    uint8_t* m_image_data;
+    const uint8_t* m_image_data;
     VkDeviceSize m_image_size;
     bool m_image_updated = false;
 
@@ -240,7 +240,7 @@ public:
     Renderer(Window& window);
     void draw_frame();
     void wait_for_device_idle();
-    void update_image(uint8_t* image_data);
+    void update_image(const uint8_t* image_data);
     void recreate_swap_chain();
     ~Renderer();
 
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include "utils/types.hpp"
+
+/*
+Walker/Vose alias table, draws an index proportional to its weight in O(1)
+*/
+class AliasTable {
+    std::vector<f32> m_probabilities;
+    std::vector<u32> m_aliases;
+    std::vector<f32> m_pmf;
+    f32 m_total = 0.0f;
+
+public:
+    AliasTable() = default;
+
+    AliasTable(std::span<const f32> weights)
+        : m_probabilities(weights.size()), m_aliases(weights.size()), m_pmf(weights.size()) {
+        f64 total = std::accumulate(weights.begin(), weights.end(), 0.0);
+        m_total = (f32)total;
+        u32 n = (u32)weights.size();
+        std::vector<f64> scaled(n);
+        for (u32 i = 0; i < n; ++i) {
+            // all zero weights fall back to a uniform distribution
+            m_pmf[i] = total > 0.0 ? (f32)(weights[i] / total) : 1.0f / (f32)n;
+            scaled[i] = (f64)m_pmf[i] * n;
+        }
+
+        std::vector<u32> small;
+        std::vector<u32> large;
+        for (u32 i = 0; i < n; ++i) {
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            u32 less = small.back();
+            small.pop_back();
+            u32 more = large.back();
+            large.pop_back();
+            m_probabilities[less] = (f32)scaled[less];
+            m_aliases[less] = more;
+            scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+            (scaled[more] < 1.0 ? small : large).push_back(more);
+        }
+        // leftovers are 1 up to rounding errors
+        for (u32 i : small) {
+            m_probabilities[i] = 1.0f;
+            m_aliases[i] = i;
+        }
+        for (u32 i : large) {
+            m_probabilities[i] = 1.0f;
+            m_aliases[i] = i;
+        }
+    }
+
+    // u in [0, 1)
+    u32 sample(f32 u) const {
+        u32 n = (u32)m_probabilities.size();
+        f32 scaled = u * (f32)n;
+        u32 index = std::min((u32)scaled, n - 1);
+        return scaled - (f32)index < m_probabilities[index] ? index : m_aliases[index];
+    }
+
+    f32 pmf(u32 index) const {
+        return m_pmf[index];
+    }
+
+    // sum of the weights the table was built from
+    f32 total() const {
+        return m_total;
+    }
+
+    u32 size() const {
+        return (u32)m_pmf.size();
+    }
+};
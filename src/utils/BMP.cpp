@@ -1,11 +1,15 @@
 #include "BMP.hpp"
+#include <string>
+#include <vector>
 
 
-void write_bmp_image(std::string_view filename, std::vector<Vec4<u8>> image, u32 width, u32 height) {
+bool write_bmp_image(std::string_view filename, std::span<const Vec4<u8>> image, u32 width, u32 height) {
+    // every row starts on a 4 byte boundary
+    u32 row_size = (width * 3 + 3) & ~3u;
     BMPHeader header;
     // Fill in BMP header fields (assumed values)
     header.type = 0x4d42;  // Magic identifier: "BM"
-    header.size = sizeof(BMPHeader) + height * width * 3; // Total file size
+    header.size = sizeof(BMPHeader) + height * row_size; // Total file size
     header.reserved1 = 0;  // Reserved fields set to 0
     header.reserved2 = 0;
     header.offset = sizeof(BMPHeader); // Offset to image data
@@ -15,26 +19,32 @@ void write_bmp_image(std::string_view filename, std::vector<Vec4<u8>> image, u32
     header.num_planes = 1; // Number of color planes
     header.bits_per_pixel = 24; // Bits per pixel
     header.compression = 0; // Compression type (none)
-    header.image_size_bytes = width * height * 3; // Image size in bytes
+    header.image_size_bytes = height * row_size; // Image size in bytes
     header.x_resolution_ppm = 2835; // 72 DPI
     header.y_resolution_ppm = 2835; // 72 DPI
     header.num_colors = 0; // Number of colors in the color palette
     header.important_colors = 0; // All colors are important
 
     // Open file for writing in binary mode
-    std::ofstream file(filename.data(), std::ios::out | std::ios::binary);
+    std::ofstream file(std::string(filename), std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
 
     // Write the header to the file
     file.write(reinterpret_cast<const char*>(&header), sizeof(BMPHeader));
 
-    // Write image data
-    for (int y = height -1; y >= 0; --y) {
+    // Write image data, bottom row first, one whole row per write
+    std::vector<u8> row(row_size, 0);
+    for (u32 y = height; y-- > 0;) {
+        const Vec4<u8>* pixels = &image[(size_t)y * width];
         for (u32 x = 0; x < width; ++x) {
-            // Assuming image is stored row-wise
-            Vec4<u8>& pixel = image[y * width + x];
-            u8 rgb[3] = {pixel.y, pixel.x, pixel.w};
-            file.write((char*)rgb, 3);
+            row[3 * x] = pixels[x].y;
+            row[3 * x + 1] = pixels[x].x;
+            row[3 * x + 2] = pixels[x].w;
         }
+        file.write(reinterpret_cast<const char*>(row.data()), row_size);
     }
     file.close();
-}
\ No newline at end of file
+    return file.good();
+}
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <string_view>
 #include <memory>
+#include <span>
 #include <array>
 #include "Pack.hpp"
 
@@ -28,4 +29,5 @@ PACK(struct BMPHeader {             // Total: 54 bytes
   u32  important_colors; // Important colors 
 });
 
-void write_bmp_image(std::string_view filename, std::vector<Vec4<u8>> image, u32 width, u32 height);
\ No newline at end of file
+// 24 bit, rows padded to 4 bytes and written whole. false when the file could not be written
+bool write_bmp_image(std::string_view filename, std::span<const Vec4<u8>> image, u32 width, u32 height);
\ No newline at end of file
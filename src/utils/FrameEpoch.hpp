@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+
+#include "utils/types.hpp"
+
+/*
+cancellation token for in flight frames. a frame remembers the epoch it started in
+and its workers stop taking new work as soon as the epoch moved on
+*/
+class FrameEpoch {
+    std::atomic<u64> m_epoch = 0;
+
+public:
+    u64 current() const {
+        return m_epoch.load(std::memory_order_acquire);
+    }
+
+    // marks every frame started before this call as stale
+    void advance() {
+        m_epoch.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    bool is_stale(u64 epoch) const {
+        return current() != epoch;
+    }
+};
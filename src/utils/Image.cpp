@@ -5,13 +5,19 @@
 #include "stb_image.h"
 
 Image::Image(std::string_view filename) {
-    img = stbi_load(filename.data(), &width, &height, &channels, 0);
-    if(img == nullptr) {
+    if (stbi_is_hdr(filename.data())) {
+        hdr_img = stbi_loadf(filename.data(), &width, &height, &channels, 0);
+    } else {
+        img = stbi_load(filename.data(), &width, &height, &channels, 0);
+    }
+    if(img == nullptr && hdr_img == nullptr) {
         panic("Failed to load image {}", filename);
     }
 }
 
 Image::~Image() {
     stbi_image_free(img);
+    stbi_image_free(hdr_img);
     img = nullptr;
-}
\ No newline at end of file
+    hdr_img = nullptr;
+}
@@ -9,6 +9,14 @@ struct Image {
     i32 height;
     i32 channels;
     u8* img = nullptr;
+    // linear float pixels, only loaded for radiance (.hdr) files, img stays null then
+    f32* hdr_img = nullptr;
     Image(std::string_view filename);
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
     ~Image();
-};
\ No newline at end of file
+
+    bool is_hdr() const {
+        return hdr_img != nullptr;
+    }
+};
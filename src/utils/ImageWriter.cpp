@@ -0,0 +1,211 @@
+#include "ImageWriter.hpp"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <fmt/core.h>
+#include "BMP.hpp"
+
+std::optional<ImageFormat> image_format(std::string_view filename) {
+    if (filename.ends_with(".bmp")) {
+        return ImageFormat::BMP;
+    }
+    if (filename.ends_with(".png")) {
+        return ImageFormat::PNG;
+    }
+    if (filename.ends_with(".pfm")) {
+        return ImageFormat::PFM;
+    }
+    return std::nullopt;
+}
+
+static constexpr std::array<u32, 256> make_crc_table() {
+    std::array<u32, 256> table{};
+    for (u32 n = 0; n < 256; ++n) {
+        u32 c = n;
+        for (u32 k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+    return table;
+}
+
+static constexpr std::array<u32, 256> CRC_TABLE = make_crc_table();
+
+static u32 crc32(const u8* data, size_t size, u32 crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = CRC_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static u32 adler32(const u8* data, size_t size) {
+    constexpr u32 modulo = 65521;
+    // the largest run that can not overflow b before taking the modulo
+    constexpr size_t run = 5552;
+    u32 a = 1;
+    u32 b = 0;
+    while (size > 0) {
+        size_t n = std::min(size, run);
+        for (size_t i = 0; i < n; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= modulo;
+        b %= modulo;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+static void push_u32_big_endian(std::vector<u8>& out, u32 value) {
+    out.push_back((u8)(value >> 24));
+    out.push_back((u8)(value >> 16));
+    out.push_back((u8)(value >> 8));
+    out.push_back((u8)value);
+}
+
+// length, type, data, crc of type and data
+static void push_png_chunk(std::vector<u8>& out, const char (&type)[5], const std::vector<u8>& data) {
+    push_u32_big_endian(out, (u32)data.size());
+    size_t crc_begin = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    push_u32_big_endian(out, crc32(&out[crc_begin], out.size() - crc_begin));
+}
+
+bool write_png_image(std::string_view filename, std::span<const Vec4<u8>> image, u32 width, u32 height) {
+    // every scanline is a filter type byte (0, none) followed by rgb
+    size_t row_size = 1 + (size_t)width * 3;
+    std::vector<u8> scanlines(row_size * height);
+    for (u32 y = 0; y < height; ++y) {
+        u8* row = &scanlines[y * row_size];
+        const Vec4<u8>* pixels = &image[(size_t)y * width];
+        row[0] = 0;
+        for (u32 x = 0; x < width; ++x) {
+            row[1 + 3 * x] = pixels[x].w;
+            row[2 + 3 * x] = pixels[x].x;
+            row[3 + 3 * x] = pixels[x].y;
+        }
+    }
+
+    // zlib stream of stored deflate blocks, each at most 65535 bytes
+    constexpr size_t block_size = 65535;
+    std::vector<u8> zlib;
+    zlib.reserve(2 + scanlines.size() + (scanlines.size() / block_size + 1) * 5 + 4);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do {
+        size_t size = std::min(block_size, scanlines.size() - offset);
+        bool last = offset + size == scanlines.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((u8)size);
+        zlib.push_back((u8)(size >> 8));
+        zlib.push_back((u8)~size);
+        zlib.push_back((u8)(~size >> 8));
+        zlib.insert(zlib.end(), scanlines.begin() + (std::ptrdiff_t)offset, scanlines.begin() + (std::ptrdiff_t)(offset + size));
+        offset += size;
+    } while (offset < scanlines.size());
+    push_u32_big_endian(zlib, adler32(scanlines.data(), scanlines.size()));
+
+    std::vector<u8> header;
+    push_u32_big_endian(header, width);
+    push_u32_big_endian(header, height);
+    // 8 bit depth, truecolor, deflate, adaptive filtering, no interlace
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+
+    std::vector<u8> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    png.reserve(png.size() + zlib.size() + 64);
+    push_png_chunk(png, "IHDR", header);
+    push_png_chunk(png, "IDAT", zlib);
+    push_png_chunk(png, "IEND", {});
+
+    std::ofstream file(std::string(filename), std::ios::out | std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), (std::streamsize)png.size());
+    file.close();
+    return file.good();
+}
+
+bool write_pfm_image(std::string_view filename, std::span<const Vec3<f32>> image, u32 width, u32 height) {
+    static_assert(sizeof(Vec3<f32>) == 3 * sizeof(f32));
+    std::ofstream file(std::string(filename), std::ios::out | std::ios::binary);
+    // a negative scale marks little endian floats
+    std::string header = fmt::format("PF\n{} {}\n-1.0\n", width, height);
+    file.write(header.data(), (std::streamsize)header.size());
+    // rows go bottom to top, each one is already contiguous rgb floats
+    for (u32 y = height; y-- > 0;) {
+        file.write(reinterpret_cast<const char*>(&image[(size_t)y * width]), (std::streamsize)(width * sizeof(Vec3<f32>)));
+    }
+    file.close();
+    return file.good();
+}
+
+ImageWriter::ImageWriter() : m_thread(&ImageWriter::run, this) {}
+
+ImageWriter::~ImageWriter() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void ImageWriter::push(std::function<void()> job) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void ImageWriter::run() {
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] {
+            return m_stop || !m_jobs.empty();
+        });
+        // pending writes are finished even when stopping
+        if (m_jobs.empty()) {
+            return;
+        }
+        std::function<void()> job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_busy = true;
+        lock.unlock();
+        job();
+        lock.lock();
+        m_busy = false;
+        m_idle.notify_all();
+    }
+}
+
+void ImageWriter::write(std::string filename, std::vector<Vec4<u8>> image, u32 width, u32 height) {
+    push([filename = std::move(filename), image = std::move(image), width, height] {
+        std::optional<ImageFormat> format = image_format(filename);
+        bool written = false;
+        if (format == ImageFormat::BMP) {
+            written = write_bmp_image(filename, image, width, height);
+        } else if (format == ImageFormat::PNG) {
+            written = write_png_image(filename, image, width, height);
+        }
+        fmt::println("{} {}", written ? "wrote" : "could not write", filename);
+    });
+}
+
+void ImageWriter::write_hdr(std::string filename, std::vector<Vec3<f32>> image, u32 width, u32 height) {
+    push([filename = std::move(filename), image = std::move(image), width, height] {
+        bool written = image_format(filename) == ImageFormat::PFM && write_pfm_image(filename, image, width, height);
+        fmt::println("{} {}", written ? "wrote" : "could not write", filename);
+    });
+}
+
+void ImageWriter::wait() {
+    std::unique_lock lock(m_mutex);
+    m_idle.wait(lock, [this] {
+        return m_jobs.empty() && !m_busy;
+    });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "linear_algebra/Vec3.hpp"
+#include "linear_algebra/Vec4.hpp"
+#include "types.hpp"
+
+enum class ImageFormat {
+    // 8 bit, uncompressed
+    BMP,
+    // 8 bit, stored (uncompressed) deflate blocks so no zlib is needed
+    PNG,
+    // 32 bit float rgb radiance
+    PFM,
+};
+
+// from the file extension, nullopt when it is none of the above
+std::optional<ImageFormat> image_format(std::string_view filename);
+
+// false when the file could not be written
+bool write_png_image(std::string_view filename, std::span<const Vec4<u8>> image, u32 width, u32 height);
+bool write_pfm_image(std::string_view filename, std::span<const Vec3<f32>> image, u32 width, u32 height);
+
+/*
+encodes and writes images on its own thread. the pixels are moved in so the caller only pays for
+the copy it hands over, never for encoding or disk io. writes run in the order they were queued
+*/
+class ImageWriter {
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_busy = false;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    void push(std::function<void()> job);
+    void run();
+
+public:
+    ImageWriter();
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+    // finishes every queued write
+    ~ImageWriter();
+
+    // .bmp or .png, 8 bit pixels in row order
+    void write(std::string filename, std::vector<Vec4<u8>> image, u32 width, u32 height);
+    // .pfm, linear radiance in row order
+    void write_hdr(std::string filename, std::vector<Vec3<f32>> image, u32 width, u32 height);
+
+    // blocks until everything queued so far is on disk
+    void wait();
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/types.hpp"
+
+/*
+memory mapping of a whole file. read only mappings fault pages in as the parser walks over them
+so nothing is copied into a heap buffer first. writable mappings create the file at a fixed size
+and the os writes the pages back, flush() forces that
+*/
+class MappedFile {
+    std::byte* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+    bool m_writable = false;
+#ifdef WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+
+    void close() {
+#ifdef WIN32
+        if (m_data != nullptr) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping != nullptr) {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+        }
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = nullptr;
+#else
+        if (m_data != nullptr) {
+            munmap(m_data, m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_open = false;
+        m_writable = false;
+    }
+
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(std::string_view path) {
+        std::string terminated(path);
+#ifdef WIN32
+        m_file = CreateFileA(
+            terminated.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+        );
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+            close();
+            return;
+        }
+        m_size = (size_t)size.QuadPart;
+        m_open = true;
+        if (m_size == 0) {
+            return;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* data = m_mapping != nullptr ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data == nullptr) {
+            close();
+            return;
+        }
+        m_data = static_cast<std::byte*>(data);
+#else
+        int fd = ::open(terminated.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return;
+        }
+        m_size = (size_t)info.st_size;
+        m_open = true;
+        // mmap refuses empty mappings, an empty file is just an empty view
+        if (m_size != 0) {
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                m_size = 0;
+                m_open = false;
+            } else {
+                madvise(data, m_size, MADV_SEQUENTIAL);
+                m_data = static_cast<std::byte*>(data);
+            }
+        }
+        // the mapping keeps the file alive on its own
+        ::close(fd);
+#endif
+    }
+
+    // creates or truncates the file to size bytes and maps it for writing
+    MappedFile(std::string_view path, size_t size) {
+        std::string terminated(path);
+#ifdef WIN32
+        m_file = CreateFileA(
+            terminated.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+        );
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        if (m_file == INVALID_HANDLE_VALUE || !SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN) ||
+            !SetEndOfFile(m_file)) {
+            close();
+            return;
+        }
+        m_size = size;
+        m_open = true;
+        m_writable = true;
+        if (m_size == 0) {
+            return;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        void* data = m_mapping != nullptr ? MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+        if (data == nullptr) {
+            close();
+            return;
+        }
+        m_data = static_cast<std::byte*>(data);
+#else
+        int fd = ::open(terminated.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return;
+        }
+        if (ftruncate(fd, (off_t)size) != 0) {
+            ::close(fd);
+            return;
+        }
+        m_size = size;
+        m_open = true;
+        m_writable = true;
+        if (m_size != 0) {
+            void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                m_size = 0;
+                m_open = false;
+            } else {
+                m_data = static_cast<std::byte*>(data);
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_open = std::exchange(other.m_open, false);
+            m_writable = std::exchange(other.m_writable, false);
+#ifdef WIN32
+            m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool is_open() const {
+        return m_open;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    std::span<const std::byte> bytes() const {
+        return {m_data, m_size};
+    }
+
+    // only for mappings opened for writing
+    std::span<std::byte> writable_bytes() {
+        return m_writable ? std::span<std::byte>(m_data, m_size) : std::span<std::byte>();
+    }
+
+    // blocks until the written pages are on disk
+    bool flush() {
+        if (m_data == nullptr || !m_writable) {
+            return m_writable;
+        }
+#ifdef WIN32
+        return FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_file);
+#else
+        return msync(m_data, m_size, MS_SYNC) == 0;
+#endif
+    }
+
+    std::string_view text() const {
+        return {reinterpret_cast<const char*>(m_data), m_size};
+    }
+};
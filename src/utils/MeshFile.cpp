@@ -0,0 +1,79 @@
+#include "MeshFile.hpp"
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include "utils/Panic.hpp"
+
+static_assert(std::is_trivially_copyable_v<Vec3<f32>>);
+static_assert(std::is_trivially_copyable_v<Coordinate>);
+static_assert(std::is_trivially_copyable_v<Vec3<Vec3<i32>>>);
+static_assert(sizeof(MeshFileHeader) == 64);
+
+static u64 align_up(u64 offset) {
+    return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+void write_mesh_file(std::string_view file_path, ObjView obj) {
+    MeshFileHeader header;
+    header.vertex_count = (u32)obj.vertices.size();
+    header.normal_count = (u32)obj.vertex_normals.size();
+    header.uv_count = (u32)obj.uv_map.size();
+    header.face_count = (u32)obj.faces.size();
+    header.vertices_offset = align_up(sizeof(MeshFileHeader));
+    header.normals_offset = align_up(header.vertices_offset + obj.vertices.size_bytes());
+    header.uvs_offset = align_up(header.normals_offset + obj.vertex_normals.size_bytes());
+    header.faces_offset = align_up(header.uvs_offset + obj.uv_map.size_bytes());
+
+    std::ofstream file{std::string(file_path), std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        panic("could not open {} for writing", file_path);
+    }
+    u64 written = 0;
+    auto write_at = [&](u64 offset, const void* data, u64 size) {
+        constexpr std::array<char, MESH_FILE_ALIGNMENT> zeros{};
+        file.write(zeros.data(), (std::streamsize)(offset - written));
+        file.write(static_cast<const char*>(data), (std::streamsize)size);
+        written = offset + size;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.vertices_offset, obj.vertices.data(), obj.vertices.size_bytes());
+    write_at(header.normals_offset, obj.vertex_normals.data(), obj.vertex_normals.size_bytes());
+    write_at(header.uvs_offset, obj.uv_map.data(), obj.uv_map.size_bytes());
+    write_at(header.faces_offset, obj.faces.data(), obj.faces.size_bytes());
+    if (!file.good()) {
+        panic("failure writing {}", file_path);
+    }
+}
+
+template <typename T>
+static std::span<const T> array_at(const MappedFile& file, u64 offset, u32 count, std::string_view file_path) {
+    if (offset % MESH_FILE_ALIGNMENT != 0 || offset > file.size() || (file.size() - offset) / sizeof(T) < count) {
+        panic("mesh file {} is truncated or corrupt", file_path);
+    }
+    return {reinterpret_cast<const T*>(file.bytes().data() + offset), count};
+}
+
+MappedMesh::MappedMesh(std::string_view file_path) : m_file(file_path) {
+    if (!m_file.is_open()) {
+        panic("Failure reading file {}", file_path);
+    }
+    MeshFileHeader header;
+    if (m_file.size() < sizeof(header)) {
+        panic("{} is not a mesh file", file_path);
+    }
+    std::memcpy(&header, m_file.bytes().data(), sizeof(header));
+    if (header.magic != MESH_FILE_MAGIC) {
+        panic("{} is not a mesh file", file_path);
+    }
+    if (header.version != MESH_FILE_VERSION) {
+        panic("{} has version {}, expected {}", file_path, header.version, MESH_FILE_VERSION);
+    }
+    m_view.vertices = array_at<Vec3<f32>>(m_file, header.vertices_offset, header.vertex_count, file_path);
+    m_view.vertex_normals = array_at<Vec3<f32>>(m_file, header.normals_offset, header.normal_count, file_path);
+    m_view.uv_map = array_at<Coordinate>(m_file, header.uvs_offset, header.uv_count, file_path);
+    m_view.faces = array_at<Vec3<Vec3<i32>>>(m_file, header.faces_offset, header.face_count, file_path);
+}
+
+bool is_mesh_file(std::string_view file_path) {
+    return file_path.ends_with(".mesh");
+}
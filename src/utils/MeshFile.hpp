@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include "utils/MappedFile.hpp"
+#include "utils/Obj.hpp"
+#include "utils/types.hpp"
+
+/*
+binary mesh file, the arrays of a ParsedObj exactly as they are laid out in memory:
+
+    MeshFileHeader
+    vertices        Vec3<f32>[vertex_count]
+    vertex normals  Vec3<f32>[normal_count]
+    uv map          Coordinate[uv_count]
+    faces           Vec3<Vec3<i32>>[face_count], vertex/uv/normal starting at 1
+
+every array starts on a MESH_FILE_ALIGNMENT boundary. the file is little endian, it is a cache
+for the machine that wrote it rather than an interchange format
+*/
+constexpr std::array<char, 8> MESH_FILE_MAGIC = {'R', 'T', 'M', 'E', 'S', 'H', '\0', '\0'};
+constexpr u32 MESH_FILE_VERSION = 1;
+constexpr u64 MESH_FILE_ALIGNMENT = 64;
+
+struct MeshFileHeader {
+    std::array<char, 8> magic = MESH_FILE_MAGIC;
+    u32 version = MESH_FILE_VERSION;
+    u32 vertex_count = 0;
+    u32 normal_count = 0;
+    u32 uv_count = 0;
+    u32 face_count = 0;
+    u32 padding = 0;
+    // byte offsets from the start of the file
+    u64 vertices_offset = 0;
+    u64 normals_offset = 0;
+    u64 uvs_offset = 0;
+    u64 faces_offset = 0;
+};
+
+// panics when the file can not be written
+void write_mesh_file(std::string_view file_path, ObjView obj);
+
+/*
+memory maps a mesh file. view() points straight into the mapping so loading costs the page faults
+of whatever reads the arrays, nothing is parsed or copied
+*/
+class MappedMesh {
+    MappedFile m_file;
+    ObjView m_view;
+
+public:
+    // panics when the file is missing, truncated or not a mesh file
+    explicit MappedMesh(std::string_view file_path);
+
+    ObjView view() const {
+        return m_view;
+    }
+};
+
+// true for paths ending in .mesh
+bool is_mesh_file(std::string_view file_path);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+multi producer queue drained in batches by a single consumer
+*/
+template <typename T>
+class MessageQueue {
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<T> m_messages;
+
+public:
+    void push(T message) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_messages.push_back(std::move(message));
+        }
+        m_condition.notify_one();
+    }
+
+    // takes every pending message in the order they were pushed
+    std::vector<T> drain() {
+        std::lock_guard lock(m_mutex);
+        return std::exchange(m_messages, {});
+    }
+
+    // blocks until a message is pending or the timeout passes
+    template <typename Rep, typename Period>
+    void wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait_for(lock, timeout, [this] {
+            return !m_messages.empty();
+        });
+    }
+};
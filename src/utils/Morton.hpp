@@ -0,0 +1,36 @@
+#pragma once
+
+#include "utils/types.hpp"
+
+// spreads the lower 16 bits of x to the even bits
+constexpr u32 morton_part_1by1(u32 x) {
+    x &= 0x0000ffffu;
+    x = (x ^ (x << 8)) & 0x00ff00ffu;
+    x = (x ^ (x << 4)) & 0x0f0f0f0fu;
+    x = (x ^ (x << 2)) & 0x33333333u;
+    x = (x ^ (x << 1)) & 0x55555555u;
+    return x;
+}
+
+// z-order curve index, neighbours in 2D stay close in 1D
+constexpr u32 morton_encode(u32 x, u32 y) {
+    return morton_part_1by1(x) | (morton_part_1by1(y) << 1);
+}
+
+// inverse of morton_part_1by1, gathers the even bits into the lower 16
+constexpr u32 morton_compact_1by1(u32 x) {
+    x &= 0x55555555u;
+    x = (x ^ (x >> 1)) & 0x33333333u;
+    x = (x ^ (x >> 2)) & 0x0f0f0f0fu;
+    x = (x ^ (x >> 4)) & 0x00ff00ffu;
+    x = (x ^ (x >> 8)) & 0x0000ffffu;
+    return x;
+}
+
+constexpr u32 morton_decode_x(u32 code) {
+    return morton_compact_1by1(code);
+}
+
+constexpr u32 morton_decode_y(u32 code) {
+    return morton_compact_1by1(code >> 1);
+}
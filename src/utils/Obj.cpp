@@ -1,110 +1,250 @@
 #include "Obj.hpp"
-#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <filesystem>
-#include <cassert>
+#include "utils/MappedFile.hpp"
 #include "utils/Panic.hpp"
 
-// parses "2.00 -1.00 3.00" to Vec3<f32> 
-static Vec3<f32> vec3_from_string(const std::string& s) {
-    Vec3<f32> out;
-    size_t first_space = s.find(' ');
-    assert(first_space != std::string::npos);
-    size_t second_space = s.find(' ', first_space + 1);
-    assert(second_space != std::string::npos);
-    out.x = stof(s.substr(0, first_space));
-    out.y = stof(s.substr(first_space + 1, second_space - first_space - 1));
-    out.z = stof(s.substr(second_space + 1));
-    assert(!isnan(out.x));
-    assert(!isnan(out.y));
-    assert(!isnan(out.z));
-    return out;
+namespace {
+
+/*
+cursor over one line of the file. every read skips the separators in front of it and parses in
+place with from_chars, so a line never becomes a temporary string
+*/
+struct LineReader {
+    const char* pos;
+    const char* end;
+    // start of the whole file, line numbers are only counted when reporting an error
+    const char* file_start;
+
+    void skip_spaces() {
+        while (pos < end && (*pos == ' ' || *pos == '\t')) {
+            ++pos;
+        }
+    }
+
+    [[noreturn]] void fail(std::string_view what) const {
+        u64 line_number = 1 + (u64)std::count(file_start, pos, '\n');
+        panic("malformed obj at line {}: expected {}", line_number, what);
+    }
+
+    f32 read_f32() {
+        skip_spaces();
+        f32 out;
+        auto [next, error] = std::from_chars(pos, end, out);
+        if (error != std::errc()) {
+            fail("a number");
+        }
+        pos = next;
+        return out;
+    }
+
+    i32 read_i32() {
+        i32 out;
+        auto [next, error] = std::from_chars(pos, end, out);
+        if (error != std::errc()) {
+            fail("an index");
+        }
+        pos = next;
+        return out;
+    }
+
+    // parses "2/3/4"
+    Vec3<i32> read_face_index() {
+        skip_spaces();
+        Vec3<i32> out;
+        out.x = read_i32();
+        if (pos == end || *pos++ != '/') {
+            fail("vertex/uv/normal");
+        }
+        out.y = read_i32();
+        if (pos == end || *pos++ != '/') {
+            fail("vertex/uv/normal");
+        }
+        out.z = read_i32();
+        return out;
+    }
+};
+
+// lengths of the vertex, uv and normal arrays at some point of the file
+struct ObjCounts {
+    u32 vertices = 0;
+    u32 uvs = 0;
+    u32 normals = 0;
+    u32 faces = 0;
+};
+
+/*
+negative indices count back from the last vertex read before the face. a chunk only knows its
+own arrays so it keeps where it was and the merge adds the counts of the chunks before it
+*/
+struct RelativeFace {
+    u32 face;
+    ObjCounts counts;
+};
+
+struct ObjChunk {
+    ParsedObj obj;
+    std::vector<RelativeFace> relative_faces;
+};
+
+ObjChunk parse_chunk(std::string_view text, const char* file_start) {
+    ObjChunk chunk;
+    ParsedObj& obj = chunk.obj;
+    const char* pos = text.data();
+    const char* text_end = text.data() + text.size();
+
+    while (pos < text_end) {
+        const char* newline = static_cast<const char*>(std::memchr(pos, '\n', (size_t)(text_end - pos)));
+        const char* line_end = newline != nullptr ? newline : text_end;
+        // windows line endings
+        const char* content_end = line_end > pos && line_end[-1] == '\r' ? line_end - 1 : line_end;
+        LineReader line{pos, content_end, file_start};
+        pos = line_end + 1;
+
+        if (content_end - line.pos < 2) {
+            continue;
+        }
+        char tag = line.pos[0];
+        char kind = line.pos[1] == '\t' ? ' ' : line.pos[1];
+        if (tag == 'v') {
+            if (kind == 't') {
+                line.pos += 2;
+                f32 x = line.read_f32();
+                f32 y = line.read_f32();
+                obj.uv_map.push_back(Coordinate{.x = x, .y = y});
+            } else if (kind == 'n' || kind == ' ') {
+                line.pos += kind == 'n' ? 2 : 1;
+                f32 x = line.read_f32();
+                f32 y = line.read_f32();
+                f32 z = line.read_f32();
+                (kind == 'n' ? obj.vertex_normals : obj.vertices).emplace_back(x, y, z);
+            }
+        } else if (tag == 'f' && kind == ' ') {
+            // parsing 1/1/1 2/3/1 3/2/4
+            line.pos += 1;
+            Vec3<i32> a = line.read_face_index();
+            Vec3<i32> b = line.read_face_index();
+            Vec3<i32> c = line.read_face_index();
+            if (a.x < 0 || a.y < 0 || a.z < 0 || b.x < 0 || b.y < 0 || b.z < 0 || c.x < 0 || c.y < 0 || c.z < 0) {
+                chunk.relative_faces.push_back(RelativeFace{
+                    .face = (u32)obj.faces.size(),
+                    .counts = {(u32)obj.vertices.size(), (u32)obj.uv_map.size(), (u32)obj.vertex_normals.size()},
+                });
+            }
+            obj.faces.push_back(Vec3(a, b, c));
+        }
+    }
+    return chunk;
 }
 
-// parses "2.00 -1.00" 
-static Coordinate coord_from_string(const std::string& s) {
-    size_t first_space = s.find(' ');
-    Coordinate out = {
-        .x = stof(s.substr(0, first_space)),
-        .y = stof(s.substr(first_space + 1)),
-    };
-    assert(!isnan(out.x));
-    assert(!isnan(out.y));
-    return out;
+void resolve_relative_index(Vec3<i32>& index, const ObjCounts& counts) {
+    if (index.x < 0) {
+        index.x += (i32)counts.vertices + 1;
+    }
+    if (index.y < 0) {
+        index.y += (i32)counts.uvs + 1;
+    }
+    if (index.z < 0) {
+        index.z += (i32)counts.normals + 1;
+    }
 }
 
-// parses "2/3/4"
-static Vec3<i32> face_index_from_string(const std::string& s) {
-    Vec3<i32> out;
-    size_t first_slash = s.find('/');
-    assert(first_slash != std::string::npos);
-    size_t second_slash = s.find('/', first_slash + 1);
-    assert(second_slash != std::string::npos);
-    out.x = stoi(s.substr(0, first_slash));
-    out.y = stoi(s.substr(first_slash + 1, second_slash - first_slash - 1));
-    out.z = stoi(s.substr(second_slash + 1));
-    return out;
+// rewrites the faces of one chunk that used negative indices to absolute ones
+void resolve_relative_faces(const ObjChunk& chunk, const ObjCounts& offset, Vec3<Vec3<i32>>* faces) {
+    for (const RelativeFace& relative : chunk.relative_faces) {
+        ObjCounts counts{
+            offset.vertices + relative.counts.vertices,
+            offset.uvs + relative.counts.uvs,
+            offset.normals + relative.counts.normals,
+        };
+        Vec3<Vec3<i32>>& face = faces[relative.face];
+        resolve_relative_index(face.x, counts);
+        resolve_relative_index(face.y, counts);
+        resolve_relative_index(face.z, counts);
+    }
 }
 
-ParsedObj load_obj(std::string_view file_path) {
-	ParsedObj obj;
-    std::ifstream stream;
-    stream.open(file_path.data(), std::ios_base::ate | std::ios_base::in);
-    if (!stream.good()) {
-        panic("Failure reading file {}", file_path);
-        fmt::println("current working directory == {}", std::filesystem::current_path().string());
+// splits the text into roughly equal parts that all end right after a newline
+std::vector<std::string_view> split_lines(std::string_view text, size_t parts) {
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    for (size_t i = 1; i <= parts && begin < text.size(); ++i) {
+        size_t end = text.find('\n', std::max(begin, text.size() * i / parts));
+        end = i == parts || end == std::string_view::npos ? text.size() : end + 1;
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
     }
-    u32 size = stream.tellg();
-    std::string text_data;
-    text_data.resize(size);
-    stream.seekg(0);
-    stream.read(text_data.data(), size);
-    stream.close();
-
-    size_t pos = 0;
-    while ((pos = text_data.find('\n')) != std::string::npos) {
-        std::string line = text_data.substr(0, pos);
-        text_data.erase(0, pos + 1);
-        
-        switch (line[0]) {
-        case 'v':
-            switch (line[1]) {
-            case 't': {
-                obj.uv_map.emplace_back(coord_from_string(line.substr(3)));
-                break;
-            }
-            case 'n': {
-                obj.vertex_normals.emplace_back(vec3_from_string(line.substr(3)));
-                break;
-            }
-            case ' ': {
-                obj.vertices.emplace_back(vec3_from_string(line.substr(2)));
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-
-        case 'f':
-            if (line[1] == ' ') {
-                // parsing 1/1/1 2/3/1 3/2/4
-                std::string s = line.substr(2);
-                size_t first_space = s.find(' ');
-                assert(first_space != std::string::npos);
-                size_t second_space = s.find(' ', first_space + 1);
-                assert(second_space != std::string::npos);
-                
-                obj.faces.push_back(Vec3(
-                    face_index_from_string(s.substr(0, first_space)),
-                    face_index_from_string(s.substr(first_space + 1, second_space - first_space - 1)),
-                    face_index_from_string(s.substr(second_space + 1))
-                ));
-            }
-            break;
+    return chunks;
+}
+
+}  // namespace
+
+ParsedObj parse_obj(std::string_view text) {
+    ObjChunk chunk = parse_chunk(text, text.data());
+    resolve_relative_faces(chunk, ObjCounts{}, chunk.obj.faces.data());
+    return std::move(chunk.obj);
+}
 
-        default:
-            break;
+ParsedObj parse_obj(std::string_view text, BS::thread_pool& pool) {
+    size_t parts = std::clamp<size_t>(text.size() / OBJ_MIN_CHUNK_SIZE, 1, 4 * (size_t)pool.get_thread_count());
+    if (parts == 1) {
+        return parse_obj(text);
+    }
+    std::vector<std::string_view> texts = split_lines(text, parts);
+    std::vector<ObjChunk> chunks(texts.size());
+    pool.parallelize_loop(texts.size(), [&](const size_t a, const size_t b) {
+        for (size_t i = a; i < b; ++i) {
+            chunks[i] = parse_chunk(texts[i], text.data());
+        }
+    }, texts.size()).wait();
+
+    // exclusive prefix sums of the chunk sizes are where each chunk goes in the merged arrays
+    std::vector<ObjCounts> offsets(chunks.size() + 1);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const ParsedObj& obj = chunks[i].obj;
+        offsets[i + 1] = ObjCounts{
+            offsets[i].vertices + (u32)obj.vertices.size(),
+            offsets[i].uvs + (u32)obj.uv_map.size(),
+            offsets[i].normals + (u32)obj.vertex_normals.size(),
+            offsets[i].faces + (u32)obj.faces.size(),
+        };
+    }
+    ParsedObj merged;
+    merged.vertices.resize(offsets.back().vertices);
+    merged.uv_map.resize(offsets.back().uvs);
+    merged.vertex_normals.resize(offsets.back().normals);
+    merged.faces.resize(offsets.back().faces);
+    pool.parallelize_loop(chunks.size(), [&](const size_t a, const size_t b) {
+        for (size_t i = a; i < b; ++i) {
+            // positive indices are already global since the arrays are concatenated in file order
+            const ParsedObj& obj = chunks[i].obj;
+            const ObjCounts& offset = offsets[i];
+            std::copy(obj.vertices.begin(), obj.vertices.end(), merged.vertices.begin() + offset.vertices);
+            std::copy(obj.uv_map.begin(), obj.uv_map.end(), merged.uv_map.begin() + offset.uvs);
+            std::copy(obj.vertex_normals.begin(), obj.vertex_normals.end(), merged.vertex_normals.begin() + offset.normals);
+            std::copy(obj.faces.begin(), obj.faces.end(), merged.faces.begin() + offset.faces);
+            resolve_relative_faces(chunks[i], offset, merged.faces.data() + offset.faces);
+            chunks[i] = ObjChunk{};
         }
+    }, chunks.size()).wait();
+    return merged;
+}
+
+static MappedFile map_obj(std::string_view file_path) {
+    MappedFile file(file_path);
+    if (!file.is_open()) {
+        fmt::println("current working directory == {}", std::filesystem::current_path().string());
+        panic("Failure reading file {}", file_path);
     }
-    return obj;
-}
\ No newline at end of file
+    return file;
+}
+
+ParsedObj load_obj(std::string_view file_path) {
+    return parse_obj(map_obj(file_path).text());
+}
+
+ParsedObj load_obj(std::string_view file_path, BS::thread_pool& pool) {
+    return parse_obj(map_obj(file_path).text(), pool);
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <vector>
+#include <span>
 #include <string_view>
 
 #include "linear_algebra/Vec3.hpp"
+#include "utils/BS_thread_pool.hpp"
 
 struct Coordinate{
 	f32 x;
@@ -16,7 +18,34 @@ struct ParsedObj {
 	std::vector<Coordinate> uv_map;
 	std::vector<Vec3<Vec3<i32>>> faces;
 };
+
+// non owning view of the arrays of a ParsedObj or of a memory mapped mesh file
+struct ObjView {
+	std::span<const Vec3<f32>> vertices;
+	std::span<const Vec3<f32>> vertex_normals;
+	std::span<const Coordinate> uv_map;
+	// vertex/uv/normal, starting at 1
+	std::span<const Vec3<Vec3<i32>>> faces;
+
+	ObjView() = default;
+	ObjView(const ParsedObj& obj)
+		: vertices(obj.vertices), vertex_normals(obj.vertex_normals), uv_map(obj.uv_map), faces(obj.faces) {}
+};
+
+/*
+supports triangulated meshes only with uv and normals included.
+parses the text in a single pass without copying it, panics with the line number on malformed input
+*/
+ParsedObj parse_obj(std::string_view text);
+// memory maps the file and parses it in place
+ParsedObj load_obj(std::string_view file_path);
+
+// files smaller than this are parsed on the calling thread
+constexpr size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
 /*
-supports triangulated meshes only with uv and normals included
+splits the text at newlines into chunks parsed concurrently on the pool, the per chunk arrays are
+then concatenated at their prefix sum offsets. relative (negative) face indices are resolved
+against the vertices of all earlier chunks. must not be called from a task of the same pool
 */
-ParsedObj load_obj(std::string_view file_path);
\ No newline at end of file
+ParsedObj parse_obj(std::string_view text, BS::thread_pool& pool);
+ParsedObj load_obj(std::string_view file_path, BS::thread_pool& pool);
\ No newline at end of file
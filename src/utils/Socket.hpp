@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "utils/types.hpp"
+
+/*
+blocking tcp stream socket. the render farm only exchanges small fixed size messages, poll()
+tells which peer has one waiting so nothing needs non blocking io. reads that take a timeout
+poll before every recv, so a peer that stops halfway through a message can not block forever
+*/
+class Socket {
+#ifdef WIN32
+    using Handle = SOCKET;
+    using Length = int;
+    static constexpr Handle INVALID_HANDLE = INVALID_SOCKET;
+#else
+    using Handle = int;
+    using Length = size_t;
+    static constexpr Handle INVALID_HANDLE = -1;
+#endif
+    Handle m_handle = INVALID_HANDLE;
+
+    explicit Socket(Handle handle) : m_handle(handle) {
+        // leases are a few bytes each, waiting to fill a packet only adds latency
+        int enable = 1;
+        setsockopt(m_handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+#ifdef SO_NOSIGPIPE
+        setsockopt(m_handle, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+    }
+
+    static void start_up() {
+#ifdef WIN32
+        static bool started = [] {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        (void)started;
+#endif
+    }
+
+    // every address host:port resolves to, tried in order until one works
+    template <typename F>
+    static Socket for_each_address(std::string_view host, u16 port, bool passive, F&& try_address) {
+        start_up();
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo* addresses = nullptr;
+        std::string service = std::to_string(port);
+        if (getaddrinfo(host.empty() ? nullptr : std::string(host).c_str(), service.c_str(), &hints, &addresses) != 0) {
+            return Socket();
+        }
+        Socket result;
+        for (addrinfo* address = addresses; address != nullptr && !result.is_open(); address = address->ai_next) {
+            Handle handle = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (handle == INVALID_HANDLE) {
+                continue;
+            }
+            Socket socket(handle);
+            if (try_address(socket.m_handle, *address)) {
+                result = std::move(socket);
+            }
+        }
+        freeaddrinfo(addresses);
+        return result;
+    }
+
+public:
+    Socket() = default;
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    Socket(Socket&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    Socket& operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            close();
+            m_handle = std::exchange(other.m_handle, INVALID_HANDLE);
+        }
+        return *this;
+    }
+
+    ~Socket() {
+        close();
+    }
+
+    // listens on host:port, port 0 picks a free one that port() returns
+    static Socket listen(std::string_view host, u16 port) {
+        return for_each_address(host, port, true, [](Handle handle, const addrinfo& address) {
+            int enable = 1;
+            setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+            return ::bind(handle, address.ai_addr, (socklen_t)address.ai_addrlen) == 0 && ::listen(handle, SOMAXCONN) == 0;
+        });
+    }
+
+    static Socket connect(std::string_view host, u16 port) {
+        return for_each_address(host, port, false, [](Handle handle, const addrinfo& address) {
+            return ::connect(handle, address.ai_addr, (socklen_t)address.ai_addrlen) == 0;
+        });
+    }
+
+    // blocks until a peer connects to a listening socket
+    Socket accept() const {
+        Handle handle = ::accept(m_handle, nullptr, nullptr);
+        return handle == INVALID_HANDLE ? Socket() : Socket(handle);
+    }
+
+    void close() {
+        if (m_handle != INVALID_HANDLE) {
+#ifdef WIN32
+            closesocket(m_handle);
+#else
+            ::close(m_handle);
+#endif
+        }
+        m_handle = INVALID_HANDLE;
+    }
+
+    bool is_open() const {
+        return m_handle != INVALID_HANDLE;
+    }
+
+    // the local port, e.g. the one the os picked for listen(host, 0)
+    u16 port() const {
+        sockaddr_storage address{};
+        socklen_t size = sizeof(address);
+        if (getsockname(m_handle, reinterpret_cast<sockaddr*>(&address), &size) != 0) {
+            return 0;
+        }
+        if (address.ss_family == AF_INET6) {
+            return ntohs(reinterpret_cast<const sockaddr_in6*>(&address)->sin6_port);
+        }
+        return ntohs(reinterpret_cast<const sockaddr_in*>(&address)->sin_port);
+    }
+
+    // false once the peer is gone, a broken connection does not raise SIGPIPE
+    bool send_all(std::span<const std::byte> data) {
+#ifdef MSG_NOSIGNAL
+        constexpr int flags = MSG_NOSIGNAL;
+#else
+        constexpr int flags = 0;
+#endif
+        while (!data.empty()) {
+            auto sent = ::send(m_handle, reinterpret_cast<const char*>(data.data()), (Length)std::min(data.size(), (size_t)1 << 30), flags);
+            if (sent <= 0) {
+                return false;
+            }
+            data = data.subspan((size_t)sent);
+        }
+        return true;
+    }
+
+    // false when the peer closed the connection before all of data arrived
+    bool receive_all(std::span<std::byte> data) {
+        while (!data.empty()) {
+            auto received = ::recv(m_handle, reinterpret_cast<char*>(data.data()), (Length)std::min(data.size(), (size_t)1 << 30), 0);
+            if (received <= 0) {
+                return false;
+            }
+            data = data.subspan((size_t)received);
+        }
+        return true;
+    }
+
+    // like receive_all, but also false when data did not arrive within timeout_ms
+    bool receive_all(std::span<std::byte> data, i32 timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        const Socket* self[] = {this};
+        while (!data.empty()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (!wait_readable(self, (i32)std::max<i64>(left, 0))[0]) {
+                return false;
+            }
+            size_t received = receive_some(data);
+            if (received == 0) {
+                return false;
+            }
+            data = data.subspan(received);
+        }
+        return true;
+    }
+
+    // reads whatever arrived, at most data.size() bytes. 0 once the peer closed the connection
+    size_t receive_some(std::span<std::byte> data) {
+        auto received = ::recv(m_handle, reinterpret_cast<char*>(data.data()), (Length)std::min(data.size(), (size_t)1 << 30), 0);
+        return received > 0 ? (size_t)received : 0;
+    }
+
+    // tells the peer nothing more is coming, it still can send
+    void shutdown_send() {
+#ifdef WIN32
+        ::shutdown(m_handle, SD_SEND);
+#else
+        ::shutdown(m_handle, SHUT_WR);
+#endif
+    }
+
+    template <typename T>
+    bool send_value(const T& value) {
+        return send_all(std::as_bytes(std::span(&value, 1)));
+    }
+
+    template <typename T>
+    bool receive_value(T& value) {
+        return receive_all(std::as_writable_bytes(std::span(&value, 1)));
+    }
+
+    template <typename T>
+    bool receive_value(T& value, i32 timeout_ms) {
+        return receive_all(std::as_writable_bytes(std::span(&value, 1)), timeout_ms);
+    }
+
+    /*
+    waits up to timeout_ms for any of the sockets to have data or a closed connection, listening
+    sockets are readable when a peer waits to be accepted. readable[i] belongs to sockets[i]
+    */
+    static std::vector<bool> wait_readable(std::span<const Socket* const> sockets, i32 timeout_ms) {
+#ifdef WIN32
+        std::vector<WSAPOLLFD> descriptors(sockets.size());
+#else
+        std::vector<pollfd> descriptors(sockets.size());
+#endif
+        for (size_t i = 0; i < sockets.size(); ++i) {
+            descriptors[i].fd = sockets[i]->m_handle;
+            descriptors[i].events = POLLIN;
+        }
+#ifdef WIN32
+        int ready = WSAPoll(descriptors.data(), (ULONG)descriptors.size(), timeout_ms);
+#else
+        int ready = ::poll(descriptors.data(), (nfds_t)descriptors.size(), timeout_ms);
+#endif
+        std::vector<bool> readable(sockets.size(), false);
+        for (size_t i = 0; i < sockets.size() && ready > 0; ++i) {
+            readable[i] = (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+        }
+        return readable;
+    }
+};
+
+// splits HOST:PORT, the host may be empty for every local address
+inline std::optional<std::pair<std::string, u16>> parse_address(std::string_view address) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string_view::npos) {
+        return std::nullopt;
+    }
+    std::string_view port_text = address.substr(colon + 1);
+    u16 port = 0;
+    auto [end, error] = std::from_chars(port_text.data(), port_text.data() + port_text.size(), port);
+    if (error != std::errc() || end != port_text.data() + port_text.size()) {
+        return std::nullopt;
+    }
+    return std::pair(std::string(address.substr(0, colon)), port);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "utils/types.hpp"
+
+/*
+hands out tiles to a fixed set of workers. every worker owns a deque seeded
+with a contiguous run of the tile list and pops from its front, once it runs
+dry it steals from the back of the other deques so neighbouring tiles mostly
+stay on the same thread
+*/
+class TileScheduler {
+    // padded so the worker locks do not share cache lines
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<u32> tiles;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+public:
+    void reset(std::span<const u32> tiles, u32 worker_count) {
+        if (m_queues.size() != worker_count) {
+            m_queues.clear();
+            for (u32 i = 0; i < worker_count; ++i) {
+                m_queues.emplace_back(std::make_unique<WorkerQueue>());
+            }
+        }
+        size_t begin = 0;
+        for (u32 worker = 0; worker < worker_count; ++worker) {
+            size_t end = tiles.size() * (worker + 1) / worker_count;
+            std::lock_guard lock(m_queues[worker]->mutex);
+            m_queues[worker]->tiles.assign(tiles.begin() + (std::ptrdiff_t)begin, tiles.begin() + (std::ptrdiff_t)end);
+            begin = end;
+        }
+    }
+
+    // puts a tile back, e.g. when its worker gave up on it. the back is where the others steal first
+    void push_back(u32 worker, u32 tile) {
+        std::lock_guard lock(m_queues[worker]->mutex);
+        m_queues[worker]->tiles.push_back(tile);
+    }
+
+    std::optional<u32> next(u32 worker) {
+        {
+            WorkerQueue& own = *m_queues[worker];
+            std::lock_guard lock(own.mutex);
+            if (!own.tiles.empty()) {
+                u32 tile = own.tiles.front();
+                own.tiles.pop_front();
+                return tile;
+            }
+        }
+        for (u32 offset = 1; offset < m_queues.size(); ++offset) {
+            WorkerQueue& victim = *m_queues[(worker + offset) % m_queues.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tiles.empty()) {
+                u32 tile = victim.tiles.back();
+                victim.tiles.pop_back();
+                return tile;
+            }
+        }
+        return std::nullopt;
+    }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include "utils/types.hpp"
+
+/*
+single producer single consumer handoff of whole frames without locks.
+the producer owns the back buffer, the consumer owns the front buffer and the
+third one sits in the middle. publishing and taking a frame are one atomic
+exchange of the middle index each, so neither side ever sees a half written frame
+*/
+template <typename T>
+class TripleBuffer {
+    // set on the middle index when it holds a frame the consumer has not taken yet
+    static constexpr u8 NEW_FRAME = 4;
+    static constexpr u8 INDEX_MASK = 3;
+
+    std::array<T, 3> m_buffers;
+    alignas(64) std::atomic<u8> m_middle = 1;
+    alignas(64) u8 m_back = 0;
+    alignas(64) u8 m_front = 2;
+
+public:
+    // producer side
+    T& back() {
+        return m_buffers[m_back];
+    }
+
+    void publish() {
+        m_back = m_middle.exchange(m_back | NEW_FRAME, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // consumer side, true when a newer frame became the front buffer
+    bool update() {
+        if ((m_middle.load(std::memory_order_relaxed) & NEW_FRAME) == 0) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const {
+        return m_buffers[m_front];
+    }
+};
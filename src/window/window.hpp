@@ -1,12 +1,14 @@
 #pragma once
 #include "ray-tracing/Camera.hpp"
-#include "utils/BMP.hpp"
+#include "utils/ImageWriter.hpp"
 #include <cstdint>
 #include <fmt/core.h>
 #include <functional>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include "utils/MathUtils.hpp"
+#include "utils/FrameEpoch.hpp"
+#include "utils/MessageQueue.hpp"
 
 struct CustomKeyCallback {
     int key;
@@ -19,6 +21,12 @@ public:
     RayTracer::Camera& cam; 
     bool framebuffer_resized = false;
     std::vector<CustomKeyCallback> custom_key_cbs;
+    // set while a render thread owns the camera, edits are queued to it instead of running here
+    MessageQueue<std::function<void()>>* commands = nullptr;
+    // advanced after queueing an edit so the render thread drops the frame it is working on
+    FrameEpoch* frame_epoch = nullptr;
+    // saves frames without holding up the render thread
+    ImageWriter image_writer;
 
 
     Window(RayTracer::Camera& cam): cam(cam) {
@@ -31,9 +39,23 @@ public:
         glfwSetFramebufferSizeCallback(m_glfw_window, this->frame_buffer_resize_event);
     };
 
+    void dispatch(std::function<void()> command, bool invalidates_frame = true) {
+        if (commands == nullptr) {
+            command();
+            return;
+        }
+        commands->push(std::move(command));
+        if (invalidates_frame && frame_epoch != nullptr) {
+            frame_epoch->advance();
+        }
+    }
+
     static void frame_buffer_resize_event(GLFWwindow* window, int width, int height) {
         Window* this_window = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
-        this_window->cam.resize_camera(width, height);
+        RayTracer::Camera* cam = &this_window->cam;
+        this_window->dispatch([cam, width, height] {
+            cam->resize_camera(width, height);
+        });
         this_window->framebuffer_resized = true;
     }
 
@@ -44,6 +66,7 @@ public:
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
         Window* this_window = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
+        RayTracer::Camera* cam = &this_window->cam;
         static f32 all_pitch_changes = 0;
         static f32 all_yaw_changes = 0;
         
@@ -51,11 +74,23 @@ public:
         f32 yaw = 0;
         switch(key) {
             case GLFW_KEY_C:
-                fmt::println("CAMERA = {} {} {}", this_window->cam.position(), all_pitch_changes, all_yaw_changes);
+                this_window->dispatch(
+                    [cam, pitch = all_pitch_changes, yaw = all_yaw_changes] {
+                        fmt::println("CAMERA = {} {} {}", cam->position(), pitch, yaw);
+                    },
+                    false
+                );
                 break;
 
             case GLFW_KEY_V:
-                write_bmp_image("render.bmp", this_window->cam.image, this_window->cam.window_width, this_window->cam.window_height);
+                // the render thread only copies the frame between passes, the writer encodes it
+                this_window->dispatch(
+                    [cam, writer = &this_window->image_writer] {
+                        writer->write("render.png", cam->image, cam->window_width, cam->window_height);
+                        writer->write_hdr("render.pfm", cam->hdr_image(), cam->window_width, cam->window_height);
+                    },
+                    false
+                );
                 break;
             case GLFW_KEY_DOWN:
                 pitch += 0.05f;
@@ -74,33 +109,45 @@ public:
                 break;
             
             case GLFW_KEY_W:
-                this_window->cam.update_z_position(0.1f);
+                this_window->dispatch([cam] {
+                    cam->update_z_position(0.1f);
+                });
                 break;
 
             case GLFW_KEY_S:
-                this_window->cam.update_z_position(-0.1f);
+                this_window->dispatch([cam] {
+                    cam->update_z_position(-0.1f);
+                });
                 break;
 
             case GLFW_KEY_D:
-                this_window->cam.update_x_position(0.1f);
+                this_window->dispatch([cam] {
+                    cam->update_x_position(0.1f);
+                });
                 break;
 
             case GLFW_KEY_A:
-                this_window->cam.update_x_position(-0.1f);
+                this_window->dispatch([cam] {
+                    cam->update_x_position(-0.1f);
+                });
                 break;
 
             case GLFW_KEY_Q:
-                this_window->cam.update_y_position(0.1f);
+                this_window->dispatch([cam] {
+                    cam->update_y_position(0.1f);
+                });
                 break;
 
             case GLFW_KEY_E:
-                this_window->cam.update_y_position(-0.1f);
+                this_window->dispatch([cam] {
+                    cam->update_y_position(-0.1f);
+                });
                 break;
 
             default:
                 for (const auto& cb: this_window->custom_key_cbs) {
                     if (cb.key == key && cb.cb != nullptr) {
-                        cb.cb();
+                        this_window->dispatch(cb.cb);
                     }
                 }
                 break;
@@ -109,8 +156,10 @@ public:
         if (pitch != 0 || yaw != 0) {
             all_pitch_changes += pitch;
             all_yaw_changes += yaw;
-            this_window->cam.rotate(pitch, yaw);
-            this_window->cam.calculate_ray_directions();
+            this_window->dispatch([cam, pitch, yaw] {
+                cam->rotate(pitch, yaw);
+                cam->calculate_ray_directions();
+            });
         }
 
     };